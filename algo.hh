@@ -175,6 +175,27 @@ namespace algo {
 		return c.erase(i + n);
 	}
 
+	// erase_marked<C>(C& c, std::vector<bool> const& marked).
+	// Erase the elements of `c` at the marked offsets in one pass, keeping the order of the rest.
+	//
+	// (TArg): C - container type
+	// Arg: C& c - container to erase from
+	// Arg: std::vector<bool> const& marked - marked[n] if the element at offset n is to be erased
+	// Pre: C::iterator is a ForwardIterator
+	template <typename C>
+	void erase_marked(C& c, std::vector<bool> const& marked)
+	{
+		auto out = c.begin();
+		std::size_t n = 0;
+		for (auto in = c.begin(); in != c.end(); ++in, ++n)
+			if (n >= marked.size() || !marked[n]) {
+				if (out != in)
+					*out = std::move(*in);
+				++out;
+			}
+		c.erase(out, c.end());
+	}
+
 }
 
 	
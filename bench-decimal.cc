@@ -0,0 +1,83 @@
+//          Copyright Andrey Moshbear 2014-2015.
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file LICENSE_1_0.txt or copy at
+//          http://www.boost.org/LICENSE_1_0.txt)
+//
+// Benchmark for price parsing: decimal::parse against strtod and boost::lexical_cast.
+
+// Args: optional
+//	-i COUNT passes over the corpus; default 100
+// Input: a price corpus, as run-rates or mock/gen-market print it; every space-separated
+//	  field which is a number in full is used
+// Output: one line per parser: { Parser Mnumbers/s ns/number }, space-delimited
+
+#include <iostream>
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <boost/lexical_cast.hpp>
+
+#include <decimal.hh>
+
+#define ARGCHK(x,a) !strncmp(x, a, sizeof a)
+
+namespace {
+
+	template <typename Parse>
+	std::vector<double> run(char const* name, std::vector<std::string> const& corpus, unsigned passes, Parse parse)
+	{
+		std::vector<double> out (corpus.size());
+		auto start = std::chrono::steady_clock::now();
+		for (unsigned i = 0; i < passes; ++i)
+			for (std::size_t j = 0; j < corpus.size(); ++j)
+				out[j] = parse(corpus[j]);
+		std::chrono::duration<double> t (std::chrono::steady_clock::now() - start);
+		double n = static_cast<double>(corpus.size()) * passes;
+		std::cout << name << ' ' << n / t.count() / 1e6 << ' ' << t.count() / n * 1e9 << '\n';
+		return out;
+	}
+}
+
+int main(int argc, char** argv) {
+	unsigned passes = 100;
+	for (int i = 1; i < argc; ++i)
+		if (ARGCHK(argv[i], "-i") && i + 1 < argc)
+			passes = static_cast<unsigned>(std::strtoul(argv[++i], nullptr, 10));
+
+	std::vector<std::string> corpus;
+	std::string line;
+	while (std::getline(std::cin, line)) {
+		for (std::size_t p = 0, q; p < line.size(); p = q + 1) {
+			q = std::min(line.find(' ', p), line.size());
+			std::string field (line, p, q - p);
+			char* end;
+			if (!field.empty() && (std::strtod(field.c_str(), &end), *end == '\0'))
+				corpus.push_back(field);
+		}
+	}
+	if (corpus.empty())
+		throw std::invalid_argument("no numbers in input");
+	std::cout << "Parser Mnumbers/s ns/number\n";
+
+	auto reference = run("strtod", corpus, passes, [] (std::string const& s) {
+		return std::strtod(s.c_str(), nullptr);
+	});
+	run("lexical_cast", corpus, passes, [] (std::string const& s) {
+		return boost::lexical_cast<double>(s);
+	});
+	auto parsed = run("decimal", corpus, passes, [] (std::string const& s) {
+		return decimal::to_double(s);
+	});
+
+	for (std::size_t i = 0; i < corpus.size(); ++i)
+		if (parsed[i] != reference[i])
+			throw std::logic_error("decimal::parse differs from strtod on " + corpus[i]);
+	std::cout.flush();
+
+	return 0;
+}
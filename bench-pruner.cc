@@ -0,0 +1,145 @@
+//          Copyright Andrey Moshbear 2014-2015.
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file LICENSE_1_0.txt or copy at
+//          http://www.boost.org/LICENSE_1_0.txt)
+//
+// Benchmark for pruner graph construction on synthetic instrument lists of growing size.
+
+// Args: optional, in any order
+//	-n COUNT largest instrument list; default 65536, starting from 1024 and doubling
+//	-c COUNT instruments per currency; default 8
+// Output: one line per size: { Instruments Currencies scan_ms ids_ms pruner_ms }, space-delimited
+//	   scan_ms builds the graph finding vertices by linear search over currency names, as pruner once did;
+//	   ids_ms builds it by interned ids, as pruner does now; pruner_ms is the whole of pruner()
+
+#include <iostream>
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <set>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <algo.hh>
+#include <g-common.hh>
+#include <symbols.hh>
+#include <pruner.hh>
+
+#define ARGCHK(x,a) !strncmp(x, a, sizeof a)
+
+namespace {
+
+	typedef std::chrono::steady_clock Clock;
+	typedef bgl::adjacency_list<bgl::vecS, bgl::vecS, bgl::undirectedS> Graph;
+	typedef g_common::VE<Graph>::Vertex Vertex;
+
+	// currency names: AAAA, AAAB, ...
+	std::string currency(std::size_t i)
+	{
+		std::string name (4, 'A');
+		for (auto p = name.rbegin(); p != name.rend(); ++p, i /= 26)
+			*p = static_cast<char>('A' + i % 26);
+		return name;
+	}
+
+	// n distinct instruments over c currencies
+	std::vector<std::string> make_instruments(std::size_t n, std::size_t c)
+	{
+		std::mt19937 rng (static_cast<std::mt19937::result_type>(n));
+		std::uniform_int_distribution<std::size_t> pick (0, c - 1);
+		std::set<std::pair<std::size_t, std::size_t>> seen;
+		std::vector<std::string> out;
+		while (out.size() < n) {
+			auto u = pick(rng), v = pick(rng);
+			if (u == v || seen.count({ v, u }) || !seen.insert({ u, v }).second)
+				continue;
+			out.push_back(currency(u) + '_' + currency(v));
+		}
+		return out;
+	}
+
+	// Graph construction with a linear search for each currency's vertex.
+	std::size_t scan_build(std::vector<std::string> const& input)
+	{
+		std::vector<std::string> nodes;
+		std::vector<std::pair<Vertex, Vertex>> edges;
+		auto vertex = [&] (std::string const& name) {
+			auto pos = algo::index_of(nodes, name);
+			if (pos == algo::npos<decltype(nodes)>::value) {
+				pos = static_cast<decltype(pos)>(nodes.size());
+				nodes.push_back(name);
+			}
+			return static_cast<Vertex>(pos);
+		};
+		for (auto const& uv : input) {
+			auto sep = uv.find(symbols::separator);
+			edges.emplace_back(vertex(uv.substr(0, sep)), vertex(uv.substr(sep + 1)));
+		}
+		Graph g (edges.begin(), edges.end(), nodes.size());
+		return bgl::num_edges(g);
+	}
+
+	// Graph construction by interned ids, with an id-indexed vertex table.
+	std::size_t id_build(std::vector<std::string> const& input)
+	{
+		std::vector<symbols::Id> nodes;
+		std::vector<std::pair<Vertex, Vertex>> edges;
+		std::vector<Vertex> vertex_of (symbols::size(), static_cast<Vertex>(-1));
+		auto vertex = [&] (symbols::Id id) {
+			if (id >= vertex_of.size())
+				vertex_of.resize(id + 1, static_cast<Vertex>(-1));
+			if (vertex_of[id] == static_cast<Vertex>(-1)) {
+				vertex_of[id] = nodes.size();
+				nodes.push_back(id);
+			}
+			return vertex_of[id];
+		};
+		for (auto const& line : input) {
+			auto uv = symbols::intern_instrument(line);
+			edges.emplace_back(vertex(uv.base), vertex(uv.quote));
+		}
+		Graph g (edges.begin(), edges.end(), nodes.size());
+		return bgl::num_edges(g);
+	}
+
+	template <typename F>
+	double time_ms(F f)
+	{
+		auto start = Clock::now();
+		f();
+		return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+	}
+}
+
+int main(int argc, char** argv) {
+	std::size_t max_n = 65536;
+	std::size_t per_currency = 8;
+	for (int i = 1; i < argc; ++i) {
+		if (ARGCHK(argv[i], "-n") && i + 1 < argc)
+			max_n = std::strtoul(argv[++i], nullptr, 10);
+		else if (ARGCHK(argv[i], "-c") && i + 1 < argc)
+			per_currency = std::max(2ul, std::strtoul(argv[++i], nullptr, 10));
+	}
+
+	std::cout << "Instruments Currencies scan_ms ids_ms pruner_ms\n";
+	std::size_t sink = 0;
+	for (std::size_t n = 1024; n <= max_n; n *= 2) {
+		auto c = n / per_currency;
+		auto input = make_instruments(n, c);
+		// intern everything once, so that both builds see a warm table
+		for (auto const& line : input)
+			symbols::intern_instrument(line);
+
+		double scan = time_ms([&] { sink += scan_build(input); });
+		double ids = time_ms([&] { sink += id_build(input); });
+		double whole = time_ms([&] { sink += pruner(input).size(); });
+		std::cout << n << ' ' << c << ' ' << scan << ' ' << ids << ' ' << whole << std::endl;
+	}
+	if (!sink)
+		std::cerr << "nothing built\n";
+
+	return 0;
+}
@@ -0,0 +1,121 @@
+//          Copyright Andrey Moshbear 2014-2015.
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file LICENSE_1_0.txt or copy at
+//          http://www.boost.org/LICENSE_1_0.txt)
+//
+// Benchmark for price response parsing: rates::parse_prices against a json-c DOM.
+
+// Args: optional, in any order
+//	-n COUNT prices per response; default 10000
+//	-i COUNT iterations; default 50
+// Output: one line per parser: { Parser MB/s prices/s }, space-delimited
+
+#include <iostream>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+extern "C" {
+#include <json-c/json.h>
+}
+
+#include <util.hh>
+#include <rates.hh>
+
+#define ARGCHK(x,a) !strncmp(x, a, sizeof a)
+
+namespace {
+
+	// A response shaped like the sandbox's, with n prices.
+	std::string make_body(std::size_t n)
+	{
+		std::string body ("{\n\t\"prices\" : [\n");
+		char entry[256];
+		for (std::size_t i = 0; i < n; ++i) {
+			double bid = 0.5 + static_cast<double>(i % 1000) / 997;
+			std::snprintf(entry, sizeof entry,
+				"%s\t\t{\n\t\t\t\"instrument\" : \"C%03zu_C%03zu\",\n"
+				"\t\t\t\"time\" : \"2015-02-10T17:16:11.000000Z\",\n"
+				"\t\t\t\"bid\" : %.5f,\n\t\t\t\"ask\" : %.5f\n\t\t}",
+				i ? ",\n" : "", i % 1000, (i / 1000) % 1000, bid, bid * 1.0002);
+			body += entry;
+		}
+		body += "\n\t]\n}";
+		return body;
+	}
+
+	// The parser rates used before: a json-c DOM, then a lookup per field.
+	std::vector<rates::Rate> parse_json_c(std::string const& body)
+	{
+		typedef json_object* J_obj;
+		std::unique_ptr<json_tokener, void(*)(json_tokener*)> tok (json_tokener_new(), json_tokener_free);
+		std::unique_ptr<json_object, int(*)(json_object*)> root (
+			json_tokener_parse_ex(tok.get(), body.data(), util::checked_cast<int>(body.size())),
+			json_object_put);
+		if (!root)
+			throw std::invalid_argument("JSON error");
+		auto json_try_get = [] (J_obj o, const char* name) -> J_obj {
+			J_obj val;
+			if (!json_object_object_get_ex(o, name, &val))
+				throw std::invalid_argument(std::string("JSON error: \"") + name + "\" not found");
+			return val;
+		};
+		std::vector<rates::Rate> result;
+		auto j_prices = json_try_get(root.get(), "prices");
+		auto nprices = json_object_array_length(j_prices);
+		for (decltype(nprices) i = 0; i < nprices; ++i) {
+			auto j_price = json_object_array_get_idx(j_prices, i);
+			result.push_back(rates::Rate(
+				json_object_get_string(json_try_get(j_price, "instrument")),
+				json_object_get_double(json_try_get(j_price, "bid")),
+				json_object_get_double(json_try_get(j_price, "ask"))));
+		}
+		return result;
+	}
+
+	template <typename Parse>
+	std::vector<rates::Rate> run(char const* name, std::string const& body, unsigned iterations, Parse parse)
+	{
+		std::vector<rates::Rate> result;
+		auto start = std::chrono::steady_clock::now();
+		for (unsigned i = 0; i < iterations; ++i)
+			result = parse(body);
+		std::chrono::duration<double> t (std::chrono::steady_clock::now() - start);
+		std::cout << name << ' ' << static_cast<double>(body.size()) * iterations / t.count() / 1e6
+			  << ' ' << static_cast<double>(result.size()) * iterations / t.count() << '\n';
+		return result;
+	}
+}
+
+int main(int argc, char** argv) {
+	std::size_t n = 10000;
+	unsigned iterations = 50;
+	for (int i = 1; i < argc; ++i) {
+		if (ARGCHK(argv[i], "-n") && i + 1 < argc)
+			n = std::strtoul(argv[++i], nullptr, 10);
+		else if (ARGCHK(argv[i], "-i") && i + 1 < argc)
+			iterations = static_cast<unsigned>(std::strtoul(argv[++i], nullptr, 10));
+	}
+
+	auto body = make_body(n);
+	std::cout << "Parser MB/s prices/s\n";
+	auto reference = run("json-c", body, iterations, parse_json_c);
+	auto parsed = run("parse_prices", body, iterations, [] (std::string const& b) {
+		return rates::parse_prices(b.data(), b.size());
+	});
+
+	if (parsed.size() != reference.size())
+		throw std::logic_error("parsers disagree on the price count");
+	for (std::size_t i = 0; i < parsed.size(); ++i)
+		if (parsed[i].instrument != reference[i].instrument
+		    || parsed[i].bid != reference[i].bid || parsed[i].ask != reference[i].ask)
+			throw std::logic_error("parsers disagree on " + reference[i].instrument);
+	std::cout.flush();
+
+	return 0;
+}
@@ -0,0 +1,220 @@
+//          Copyright Andrey Moshbear 2014-2015.
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file LICENSE_1_0.txt or copy at
+//          http://www.boost.org/LICENSE_1_0.txt)
+//
+// Benchmark for the shared memory ring against a pipe, between two processes.
+
+// Args: optional, in any order
+//	-n COUNT messages for the latency test; default 100000
+//	-m MB for the throughput test; default 256
+// Output: one line per transport: { Transport p50_ns p99_ns MB/s }, space-delimited
+//	   latency is one-way, of a flushed 64-byte message; throughput of 4 KiB writes
+//	   the data is checked on arrival
+//	   the ends are written with sputn and read with sgetn, as frame::Writer and frame::Reader do
+
+#include <iostream>
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <ring.hh>
+
+#define ARGCHK(x,a) !strncmp(x, a, sizeof a)
+
+namespace {
+
+	typedef std::chrono::steady_clock Clock;
+
+	const std::size_t message_size = 64;
+	const std::size_t block_size = 4096;
+
+	std::int64_t now_ns()
+	{
+		return std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now().time_since_epoch()).count();
+	}
+
+	// Byte stream ends: a ring, or a pipe.
+	struct Source {
+		virtual ~Source() { }
+		// read exactly n bytes; false at the end of the stream
+		virtual bool read(char* p, std::size_t n) = 0;
+	};
+	struct Sink {
+		virtual ~Sink() { }
+		virtual void write(char const* p, std::size_t n) = 0;
+		virtual void flush() = 0;
+	};
+
+	struct Ring_source : Source {
+		ring::Reader r;
+		Ring_source(std::string const& name, ring::Wait w) : r(name, w) { }
+		bool read(char* p, std::size_t n) override
+		{ return static_cast<std::size_t>(r.sgetn(p, static_cast<std::streamsize>(n))) == n; }
+	};
+	struct Ring_sink : Sink {
+		ring::Writer w;
+		Ring_sink(std::string const& name, ring::Wait wait) : w(name, wait) { }
+		void write(char const* p, std::size_t n) override
+		{ w.sputn(p, static_cast<std::streamsize>(n)); }
+		void flush() override
+		{ w.pubsync(); }
+	};
+	struct Pipe_source : Source {
+		int fd;
+		explicit Pipe_source(int fd_) : fd(fd_) { }
+		~Pipe_source() { ::close(fd); }
+		bool read(char* p, std::size_t n) override {
+			while (n) {
+				auto k = ::read(fd, p, n);
+				if (k <= 0)
+					return false;
+				p += k;
+				n -= static_cast<std::size_t>(k);
+			}
+			return true;
+		}
+	};
+	struct Pipe_sink : Sink {
+		int fd;
+		explicit Pipe_sink(int fd_) : fd(fd_) { }
+		~Pipe_sink() { ::close(fd); }
+		void write(char const* p, std::size_t n) override {
+			while (n) {
+				auto k = ::write(fd, p, n);
+				if (k <= 0)
+					throw std::runtime_error("pipe write failed");
+				p += k;
+				n -= static_cast<std::size_t>(k);
+			}
+		}
+		void flush() override { }
+	};
+
+	struct Options {
+		std::size_t messages = 100000;
+		std::size_t megabytes = 256;
+	} options;
+
+	// Consumer: report latencies and throughput back over a pipe.
+	void consume(Source& in, int report)
+	{
+		std::vector<std::int64_t> latency;
+		latency.reserve(options.messages);
+		char msg[message_size];
+		for (std::size_t i = 0; i < options.messages; ++i) {
+			if (!in.read(msg, sizeof msg))
+				throw std::logic_error("stream ended early");
+			auto t = now_ns();
+			std::int64_t sent;
+			std::memcpy(&sent, msg, sizeof sent);
+			latency.push_back(t - sent);
+		}
+		std::sort(latency.begin(), latency.end());
+		std::int64_t out[3] = { latency[latency.size() / 2], latency[latency.size() * 99 / 100], 0 };
+
+		std::vector<char> block (block_size);
+		std::uint64_t expect = 0;
+		auto start = Clock::now();
+		for (std::size_t n = options.megabytes << 20; n; n -= block_size) {
+			if (!in.read(block.data(), block_size))
+				throw std::logic_error("stream ended early");
+			for (std::size_t i = 0; i < block_size; i += sizeof expect, ++expect)
+				if (std::memcmp(&block[i], &expect, sizeof expect))
+					throw std::logic_error("corrupt data");
+		}
+		std::chrono::duration<double> t (Clock::now() - start);
+		out[2] = static_cast<std::int64_t>(static_cast<double>(options.megabytes) / t.count());
+		if (::write(report, out, sizeof out) != sizeof out)
+			throw std::runtime_error("report failed");
+	}
+
+	void produce(Sink& out)
+	{
+		char msg[message_size] = { };
+		for (std::size_t i = 0; i < options.messages; ++i) {
+			// pace the messages, so that they are waited for rather than queued
+			auto until = now_ns() + 2000;
+			while (now_ns() < until)
+				;
+			auto t = now_ns();
+			std::memcpy(msg, &t, sizeof t);
+			out.write(msg, sizeof msg);
+			out.flush();
+		}
+		std::vector<char> block (block_size);
+		std::uint64_t seq = 0;
+		for (std::size_t n = options.megabytes << 20; n; n -= block_size) {
+			for (std::size_t i = 0; i < block_size; i += sizeof seq, ++seq)
+				std::memcpy(&block[i], &seq, sizeof seq);
+			out.write(block.data(), block_size);
+		}
+		out.flush();
+	}
+
+	void run(std::string const& transport, ring::Wait wait)
+	{
+		static int runs = 0;
+		std::string name = "/currex-bench-ring-" + std::to_string(::getpid()) + '-' + std::to_string(++runs);
+		int data[2], report[2];
+		if (::pipe(data) || ::pipe(report))
+			throw std::runtime_error("pipe failed");
+		auto pid = ::fork();
+		if (pid < 0)
+			throw std::runtime_error("fork failed");
+		if (!pid) {
+			::close(report[0]);
+			::close(data[1]);
+			{
+				std::unique_ptr<Source> in;
+				if (transport == "pipe")
+					in.reset(new Pipe_source(data[0]));
+				else
+					in.reset(new Ring_source(name, wait));
+				consume(*in, report[1]);
+			}
+			std::_Exit(0);
+		}
+		::close(report[1]);
+		::close(data[0]);
+		{
+			std::unique_ptr<Sink> out;
+			if (transport == "pipe")
+				out.reset(new Pipe_sink(data[1]));
+			else
+				out.reset(new Ring_sink(name, wait));
+			produce(*out);
+		}
+		std::int64_t result[3];
+		if (::read(report[0], result, sizeof result) != sizeof result)
+			throw std::runtime_error("consumer failed");
+		::waitpid(pid, nullptr, 0);
+		::close(report[0]);
+		std::cout << transport << ' ' << result[0] << ' ' << result[1] << ' ' << result[2] << std::endl;
+	}
+}
+
+int main(int argc, char** argv) {
+	for (int i = 1; i < argc; ++i) {
+		if (ARGCHK(argv[i], "-n") && i + 1 < argc)
+			options.messages = std::max(1ul, std::strtoul(argv[++i], nullptr, 10));
+		else if (ARGCHK(argv[i], "-m") && i + 1 < argc)
+			options.megabytes = std::strtoul(argv[++i], nullptr, 10);
+	}
+
+	std::cout << "Transport p50_ns p99_ns MB/s\n";
+	run("pipe", ring::Wait::futex);
+	run("ring-futex", ring::Wait::futex);
+	run("ring-poll", ring::Wait::poll);
+
+	return 0;
+}
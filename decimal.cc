@@ -0,0 +1,161 @@
+//          Copyright Andrey Moshbear 2014-2015.
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file LICENSE_1_0.txt or copy at
+//          http://www.boost.org/LICENSE_1_0.txt)
+//
+// Decimal conversion implementation
+//
+// The fast path is Clinger's: when the significand and the power of ten are both exactly
+// representable as doubles, one IEEE multiplication or division is correctly rounded.
+// That needs double arithmetic to be done in double precision (FLT_EVAL_METHOD == 0),
+// as it is with SSE2; x87 extended precision would round twice.
+
+#include <cfloat>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <stdexcept>
+
+#include <locale.h>
+#include <stdlib.h>
+
+#include <decimal.hh>
+
+#if !defined(FLT_EVAL_METHOD) || FLT_EVAL_METHOD != 0
+#error "decimal.cc requires double arithmetic in double precision"
+#endif
+
+namespace {
+
+	// exactly representable powers of ten
+	const double powers_of_ten[] = {
+		1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10,
+		1e11, 1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+	};
+	const int max_pow10 = 22;
+	// significands up to 2^53 are exact
+	const std::uint64_t max_exact = std::uint64_t(1) << 53;
+	// 19 digits always fit in 64 bits
+	const int max_digits = 19;
+
+	bool is_digit(char c)
+	{ return c >= '0' && c <= '9'; }
+
+	// C locale for the slow path, made once.
+	locale_t c_locale()
+	{
+		static locale_t loc = newlocale(LC_ALL_MASK, "C", static_cast<locale_t>(0));
+		return loc;
+	}
+
+	double slow(char const* first, char const* last)
+	{
+		char buf[64];
+		std::string big;
+		auto n = static_cast<std::size_t>(last - first);
+		char const* s;
+		if (n < sizeof buf) {
+			std::memcpy(buf, first, n);
+			buf[n] = '\0';
+			s = buf;
+		} else {
+			big.assign(first, last);
+			s = big.c_str();
+		}
+		return strtod_l(s, nullptr, c_locale());
+	}
+}
+
+char const* decimal::parse(char const* first, char const* last, double& value)
+{
+	char const* p = first;
+	bool negative = false;
+	if (p != last && (*p == '-' || *p == '+'))
+		negative = (*p++ == '-');
+
+	std::uint64_t m = 0;
+	int digits = 0;		// significant digits in m
+	int dropped = 0;	// integer digits that didn't fit in m
+	bool inexact = false;	// nonzero digits were dropped
+	int scale = 0;		// fractional digits in m
+	bool any = false;
+
+	for (; p != last && is_digit(*p); ++p, any = true) {
+		if (digits < max_digits) {
+			m = m * 10 + static_cast<unsigned>(*p - '0');
+			digits += (m != 0);
+		} else {
+			++dropped;
+			inexact |= (*p != '0');
+		}
+	}
+	if (p != last && *p == '.') {
+		char const* frac = ++p;
+		for (; p != last && is_digit(*p); ++p) {
+			if (digits < max_digits) {
+				m = m * 10 + static_cast<unsigned>(*p - '0');
+				digits += (m != 0);
+				++scale;
+			} else {
+				inexact |= (*p != '0');
+			}
+		}
+		any |= (p != frac);
+	}
+	if (!any)
+		return first;
+
+	long exponent = 0;
+	if (p != last && (*p == 'e' || *p == 'E')) {
+		char const* e = p + 1;
+		bool e_negative = false;
+		if (e != last && (*e == '-' || *e == '+'))
+			e_negative = (*e++ == '-');
+		if (e != last && is_digit(*e)) {
+			for (; e != last && is_digit(*e); ++e)
+				if (exponent < 100000)
+					exponent = exponent * 10 + (*e - '0');
+			if (e_negative)
+				exponent = -exponent;
+			p = e;
+		}
+		// otherwise the 'e' isn't part of the number
+	}
+
+	exponent += dropped - scale;
+	if (!inexact && m <= max_exact) {
+		double d = static_cast<double>(m);
+		bool fast = true;
+		if (m == 0 || exponent == 0)
+			;
+		else if (exponent < 0 && exponent >= -max_pow10)
+			d /= powers_of_ten[-exponent];
+		else if (exponent > 0 && exponent <= max_pow10)
+			d *= powers_of_ten[exponent];
+		else if (exponent > max_pow10 && exponent <= max_pow10 + 15) {
+			// move the excess into the significand, if it stays exact
+			auto k = exponent - max_pow10;
+			std::uint64_t mk = m;
+			for (; k && mk <= max_exact / 10; --k)
+				mk *= 10;
+			fast = !k;
+			d = static_cast<double>(mk) * powers_of_ten[max_pow10];
+		} else
+			fast = false;
+		if (fast) {
+			value = negative ? -d : d;
+			return p;
+		}
+	}
+	value = slow(first, p);
+	return p;
+}
+
+double decimal::to_double(char const* first, char const* last)
+{
+	double d;
+	if (first == last || parse(first, last, d) != last)
+		throw std::invalid_argument("bad number: `" + std::string(first, last) + "'");
+	return d;
+}
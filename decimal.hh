@@ -0,0 +1,41 @@
+//          Copyright Andrey Moshbear 2014-2015.
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file LICENSE_1_0.txt or copy at
+//          http://www.boost.org/LICENSE_1_0.txt)
+//
+// Locale-free decimal to double conversion, for prices.
+//
+#ifndef DECIMAL_HH
+#define DECIMAL_HH
+
+#include <string>
+
+namespace decimal {
+
+	// char const* parse(char const*, char const*, double&).
+	// Parse the longest prefix of [first, last) of the form
+	//	[+-] digits [. digits] [(e|E) [+-] digits]
+	// where either digit run before the exponent may be empty, but not both.
+	// The result is correctly rounded, and doesn't depend on the C or C++ locale.
+	// Up to 19 significant digits with a small enough exponent, as prices have, are converted
+	// exactly in a few arithmetic operations; anything else goes through strtod_l in the C locale.
+	//
+	// Arg: char const* first, char const* last - the text
+	// Arg: double& value - the result; untouched if no number is found
+	// Ret: the end of the number, or first if there is none
+	char const* parse(char const* first, char const* last, double& value);
+
+	// double to_double(char const*, char const*).
+	// Convert a whole range as per parse().
+	//
+	// Arg: char const* first, char const* last - the text
+	// Ret: its value
+	// Throw: std::invalid_argument unless the whole range is a number
+	double to_double(char const* first, char const* last);
+
+	inline double to_double(std::string const& s)
+	{ return to_double(s.data(), s.data() + s.size()); }
+
+}
+
+#endif
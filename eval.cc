@@ -3,8 +3,22 @@
 //    (See accompanying file LICENSE_1_0.txt or copy at
 //          http://www.boost.org/LICENSE_1_0.txt)
 //
-// eval.cc - REPL
+// eval.cc - REPL, or a daemon running the whole pipeline at a fixed cadence
+//
+// Args: optional, in any order
+//	-d LEVELS sets debug levels
+//	-r MS runs as a daemon instead of reading commands: rates are refreshed and the best path
+//	      searched every MS milliseconds, and printed as run-graph prints it
+//	-i CYCLES refreshes the instrument list and re-prunes every CYCLES cycles; default 60
+//	-n COUNT stops the daemon after COUNT cycles; default 0, never
+//	-l LIMIT caps the search iterations per cycle; default none
 #include <iostream>
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <future>
+#include <thread>
 #include <cmath>
 #include <vector>
 #include <map>
@@ -16,6 +30,7 @@
 #include <mutex>
 
 #include <d.hh>
+#include <http.hh>
 #include <instr-ls.hh>
 #include <pruner.hh>
 #include <rates.hh>
@@ -226,6 +241,7 @@ namespace {
 		getvar_handler["graph"] = [] { set_output(labeled_graph); };
 		getvar_handler["path"] = [] { set_output(best_path.path); };
 		getvar_handler["lrate"] = [] { set_output(best_path.lrate); };
+		getvar_handler["http"] = [] { set_output(http::phase_stats()); };
 		// I_ is for internals
 		getvar_handler["I_isset"] = [] {
 						std::vector<char> OV;
@@ -237,6 +253,68 @@ namespace {
 						set_output_V(OV);
 					};
 	}
+	// Daemon.
+
+	struct Daemon_options {
+		std::chrono::milliseconds period;
+		unsigned long long instr_every;
+		unsigned long long cycles;
+		long ilim;
+	};
+
+	// Print the best path as run-graph does.
+	void print_best_path()
+	{
+		auto const& P (best_path.path);
+		auto const& labels (labeled_graph.labels);
+		for (std::size_t i = 0; i < P.size(); ++i)
+			std::cout << labels[P[i]] << (i + 1 < P.size() ? ";" : "");
+		std::cout << ' ' << best_path.lrate << std::endl;
+	}
+
+	// Run the pipeline every period. The instrument list is refreshed in the background,
+	// so the rate cycle only ever waits for it on the first cycle; the graph is kept across
+	// cycles and updated in place.
+	void run_daemon(Daemon_options const& opts)
+	{
+		D_push_id(daemon);
+		std::future<std::vector<std::string>> listing;
+		// collecting the last listing threw; it's retried next cycle rather than at the next instr_every
+		bool relist = false;
+		auto next = std::chrono::steady_clock::now();
+		for (unsigned long long cycle = 0; !opts.cycles || cycle < opts.cycles; ++cycle) {
+			try {
+				if (!listing.valid() && (cycle % opts.instr_every == 0 || relist || !check(IS_SET::pruned)))
+					listing = instruments::list_async();
+				if (listing.valid() && (!check(IS_SET::pruned)
+				    || listing.wait_for(std::chrono::seconds(0)) == std::future_status::ready)) {
+					relist = true; // until get() returns
+					instrument_list = listing.get();
+					relist = false;
+					provide(IS_SET::instr);
+					pruned_instruments = pruner(instrument_list);
+					provide(IS_SET::pruned);
+					D_print(D_info, std::cerr, "Instruments refreshed");
+				}
+				rate_list = rates::get(pruned_instruments);
+				provide(IS_SET::rates);
+				graph::load_graph_from_rates(labeled_graph, rate_list);
+				provide(IS_SET::graph);
+				best_path = graph::best_path(labeled_graph, static_cast<size_t>(opts.ilim));
+				provide(IS_SET::best_path);
+				print_best_path();
+			} catch (std::exception const& e) {
+				// a failed cycle is reported and the next one tried; a failed listing is retried
+				std::cout << "Error: " << e.what() << std::endl;
+			}
+			next += opts.period;
+			auto now = std::chrono::steady_clock::now();
+			if (next < now)
+				next = now; // overran; don't try to catch up
+			std::this_thread::sleep_until(next);
+		}
+	}
+
 	void init_command_handlers()
 	{
 		command_handler["setd"] = set_dlevel;
@@ -252,6 +330,21 @@ namespace {
 
 int main(int argc, char** argv) {
 	D_set_from_args(argc - 1, argv + 1, "-d");
+	Daemon_options daemon { std::chrono::milliseconds(0), 60, 0, -1 };
+	for (int i = 1; i + 1 < argc; ++i) {
+		if (!std::strcmp(argv[i], "-r"))
+			daemon.period = std::chrono::milliseconds(std::strtoul(argv[++i], nullptr, 10));
+		else if (!std::strcmp(argv[i], "-i"))
+			daemon.instr_every = std::max(1ull, std::strtoull(argv[++i], nullptr, 10));
+		else if (!std::strcmp(argv[i], "-n"))
+			daemon.cycles = std::strtoull(argv[++i], nullptr, 10);
+		else if (!std::strcmp(argv[i], "-l"))
+			daemon.ilim = std::strtol(argv[++i], nullptr, 10);
+	}
+	if (daemon.period.count()) {
+		run_daemon(daemon);
+		return 0;
+	}
 	init_command_handlers();
 	std::string cmd;
 	while (std::cin >> cmd) {
@@ -0,0 +1,166 @@
+//          Copyright Andrey Moshbear 2014-2015.
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file LICENSE_1_0.txt or copy at
+//          http://www.boost.org/LICENSE_1_0.txt)
+//
+// feed implementation: line splitting and tick parsing
+//
+// Linking dependencies: -ljson-c -lboost_system -lpthread -lz
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstring>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <stdexcept>
+#include <vector>
+
+extern "C" {
+#include <json-c/json.h>
+}
+
+#include <util.hh>
+#include <http.hh>
+#include <feed.hh>
+
+namespace {
+
+	typedef json_object* J_obj; // non-refcounted json_object
+
+	J_obj json_try_get(J_obj root, const char* name) {
+		J_obj val;
+		if (!json_object_object_get_ex(root, name, &val))
+			throw std::invalid_argument(std::string("JSON error: \"") + name + "\" not found");
+		return val;
+	}
+
+	http::Uri make_query_url(std::vector<std::string> const& instruments,
+				 std::string const& domain, std::string const& service) {
+		if (instruments.empty())
+			throw std::invalid_argument("empty vector");
+		std::string q("/v1/prices?instruments=");
+		for (auto const& instr : instruments) {
+			q += instr;
+			q += "%2C";
+		}
+		q.resize(q.size() - 3);
+		return {{ service, domain, q }};
+	}
+}
+
+// Stream state shared with the I/O thread.
+struct feed::Stream::State {
+	Tick_handler on_tick;
+	std::unique_ptr<json_tokener, void(*)(json_tokener*)> tok;
+	// incomplete last line of the body received so far
+	std::string partial;
+	std::atomic<unsigned long long> ticks;
+
+	std::mutex mtx;
+	std::condition_variable cv;
+	bool ended;
+	std::exception_ptr error;
+
+	State(Tick_handler f)
+	: on_tick(std::move(f)), tok(json_tokener_new(), json_tokener_free), ticks(0), ended(false)
+	{ }
+
+	// Split a body piece into lines; lines which arrive whole aren't copied.
+	void operator() (char const* data, std::size_t n) {
+		while (n) {
+			auto eol = static_cast<char const*>(std::memchr(data, '\n', n));
+			if (!eol) {
+				partial.append(data, n);
+				return;
+			}
+			auto len = static_cast<std::size_t>(eol - data);
+			if (partial.empty()) {
+				line(data, len);
+			} else {
+				partial.append(data, len);
+				line(partial.data(), partial.size());
+				partial.clear();
+			}
+			data += len + 1;
+			n -= len + 1;
+		}
+	}
+
+	void line(char const* data, std::size_t n) {
+		if (n && data[n - 1] == '\r')
+			--n;
+		if (!n)
+			return;
+		json_tokener_reset(tok.get());
+		std::unique_ptr<json_object, int(*)(json_object*)> root (
+			json_tokener_parse_ex(tok.get(), data, util::checked_cast<int>(n)), json_object_put);
+		if (!root)
+			throw std::invalid_argument(std::string("JSON error: ")
+				+ json_tokener_error_desc(json_tokener_get_error(tok.get())));
+		J_obj j_tick;
+		if (json_object_object_get_ex(root.get(), "tick", &j_tick)) {
+			rates::Rate rate (
+				json_object_get_string(json_try_get(j_tick, "instrument")),
+				json_object_get_double(json_try_get(j_tick, "bid")),
+				json_object_get_double(json_try_get(j_tick, "ask")));
+			on_tick(rate);
+			++ticks;
+		} else if (json_object_object_get_ex(root.get(), "disconnect", nullptr)) {
+			throw std::invalid_argument(std::string("price stream disconnected: ")
+				+ json_object_to_json_string(root.get()));
+		} else if (!json_object_object_get_ex(root.get(), "heartbeat", nullptr)) {
+			throw std::invalid_argument("JSON error: unexpected message in price stream");
+		}
+	}
+
+	void end(std::exception_ptr e) {
+		std::lock_guard<std::mutex> lock(mtx);
+		if (ended)
+			return;
+		ended = true;
+		error = e;
+		cv.notify_all();
+	}
+};
+
+feed::Stream::Stream(std::vector<std::string> const& instruments, Tick_handler on_tick,
+		     std::string const& domain, std::string const& service)
+: state(std::make_shared<State>(std::move(on_tick))), client(new http::Client(1))
+{
+	auto s (state);
+	client->async_query(make_query_url(instruments, domain, service),
+		[s] (char const* data, std::size_t n) { (*s)(data, n); },
+		[s] (std::exception_ptr e) {
+			if (!e && !s->partial.empty())
+				e = std::make_exception_ptr(std::logic_error("price stream ended mid-line"));
+			s->end(e);
+		});
+}
+
+feed::Stream::~Stream()
+{
+	stop();
+}
+
+void feed::Stream::stop()
+{
+	// Destroying the client stops its I/O thread, abandoning the request.
+	client.reset();
+	state->end(std::exception_ptr());
+}
+
+void feed::Stream::wait()
+{
+	std::unique_lock<std::mutex> lock(state->mtx);
+	state->cv.wait(lock, [this] { return state->ended; });
+	if (state->error)
+		std::rethrow_exception(state->error);
+}
+
+unsigned long long feed::Stream::ticks() const
+{
+	return state->ticks;
+}
@@ -0,0 +1,77 @@
+//          Copyright Andrey Moshbear 2014-2015.
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file LICENSE_1_0.txt or copy at
+//          http://www.boost.org/LICENSE_1_0.txt)
+//
+// Streaming price feed: rates as they change, rather than as polled by rates::get.
+//
+#ifndef FEED_HH
+#define FEED_HH
+
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <rates.hh>
+
+namespace http {
+	class Client;
+}
+
+namespace feed {
+
+// Subscriber to a price stream.
+// Called on the stream's I/O thread with each tick, in arrival order; an exception thrown
+// by a subscriber ends the stream and is rethrown by Stream::wait().
+typedef std::function<void(rates::Rate const&)> Tick_handler;
+
+// Stream.
+// One long-lived HTTP response from the streaming price server, kept open for the
+// lifetime of the object. Its chunked body is newline-delimited JSON, one message per line:
+//	{"tick":{"instrument":"EUR_USD","time":"...","bid":1.1,"ask":1.2}}
+// Ticks are parsed as they arrive and handed to the subscriber; heartbeats are skipped.
+//
+// A stream has an http::Client of its own, so the timing of http::client() doesn't apply.
+class Stream
+{
+public:
+	// Stream(std::vector<std::string> const&, Tick_handler, std::string const&, std::string const&).
+	// Subscribe to price ticks of `instruments`.
+	//
+	// Arg: std::vector<std::string> const& instruments - the instruments to follow
+	// Arg: Tick_handler on_tick - subscriber
+	// Arg: std::string const& domain - streaming server
+	// Arg: std::string const& service - protocol or port of the server
+	// Throw: std::invalid_argument if instruments is empty
+	Stream(std::vector<std::string> const& instruments, Tick_handler on_tick,
+	       std::string const& domain = "stream-sandbox.oanda.com", std::string const& service = "http");
+	// Stops the stream.
+	~Stream();
+	Stream(Stream const&) = delete;
+	Stream& operator= (Stream const&) = delete;
+
+	// void stop().
+	// Close the stream; no tick is delivered once stop() has returned.
+	// Must not be called from the subscriber.
+	void stop();
+
+	// void wait().
+	// Block until the stream has ended, by the server closing it or by stop().
+	//
+	// Throw: whatever ended the stream, as http::query would; nothing if stopped
+	void wait();
+
+	// unsigned long long ticks() const.
+	// Ret: number of ticks delivered so far
+	unsigned long long ticks() const;
+
+private:
+	struct State;
+	std::shared_ptr<State> state;
+	std::unique_ptr<http::Client> client;
+};
+
+}
+
+#endif
@@ -0,0 +1,207 @@
+//          Copyright Andrey Moshbear 2014-2015.
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file LICENSE_1_0.txt or copy at
+//          http://www.boost.org/LICENSE_1_0.txt)
+//
+// Framed protocol implementation
+
+#include <cstdint>
+#include <cstring>
+#include <ios>
+#include <istream>
+#include <ostream>
+#include <string>
+#include <stdexcept>
+#include <vector>
+
+#include <util.hh>
+#include <frame.hh>
+
+namespace {
+
+	struct Instrument_payload {
+		std::uint32_t base;
+		std::uint32_t quote;
+	};
+
+	struct Rate_payload {
+		std::uint32_t base;
+		std::uint32_t quote;
+		double bid;
+		double ask;
+	};
+
+	static_assert(sizeof(Rate_payload) == 24, "Rate_payload isn't packed");
+
+	// frame header: length and type
+	const std::size_t header_size = 5;
+	// no legitimate frame comes near this
+	const std::uint32_t max_payload = 1 << 20;
+}
+
+frame::Writer::Writer(std::ostream& os_)
+: os(os_)
+{ }
+
+frame::Writer::~Writer()
+{
+	try {
+		flush();
+	} catch (...) {
+	}
+}
+
+void frame::Writer::instrument(symbols::Instrument instr)
+{
+	currency(instr.base);
+	currency(instr.quote);
+	Instrument_payload p { instr.base, instr.quote };
+	put(Type::instrument, &p, sizeof p);
+}
+
+void frame::Writer::rate(rates::Rate const& r)
+{
+	currency(r.symbol.base);
+	currency(r.symbol.quote);
+	Rate_payload p { r.symbol.base, r.symbol.quote, r.bid, r.ask };
+	put(Type::rate, &p, sizeof p);
+}
+
+void frame::Writer::flush()
+{
+	if (!os.flush())
+		throw std::runtime_error("can't write frames");
+}
+
+void frame::Writer::currency(symbols::Id id)
+{
+	if (id < sent.size() && sent[id])
+		return;
+	if (id >= sent.size())
+		sent.resize(id + 1, false);
+	sent[id] = true;
+	auto const& name = symbols::name(id);
+	put(Type::currency, &id, sizeof id, name.data(), name.size());
+}
+
+void frame::Writer::put(Type t, void const* payload, std::size_t n, void const* tail, std::size_t tail_n)
+{
+	auto length = util::checked_cast<std::uint32_t>(n + tail_n);
+	// header and fixed payload are assembled here; the rest goes from where it is
+	char frame[header_size + sizeof(Rate_payload)];
+	if (n > sizeof(Rate_payload))
+		throw std::invalid_argument("frame payload too long");
+	std::memcpy(frame, &length, sizeof length);
+	frame[4] = static_cast<char>(t);
+	std::memcpy(frame + header_size, payload, n);
+	write(frame, header_size + n);
+	if (tail_n)
+		write(static_cast<char const*>(tail), tail_n);
+}
+
+void frame::Writer::write(char const* data, std::size_t n)
+{
+	auto m = util::checked_cast<std::streamsize>(n);
+	if (os.rdbuf()->sputn(data, m) != m) {
+		os.setstate(std::ios::badbit);
+		throw std::runtime_error("can't write frames");
+	}
+}
+
+frame::Reader::Reader(std::istream& is_)
+: is(is_)
+{ }
+
+bool frame::Reader::next(Message& m)
+{
+	for (;;) {
+		char header[header_size];
+		is.read(header, header_size);
+		if (is.gcount() == 0 && is.eof())
+			return false;
+		if (is.gcount() != static_cast<std::streamsize>(header_size))
+			throw std::logic_error("frame stream ends mid-frame");
+		std::uint32_t length;
+		std::memcpy(&length, header, sizeof length);
+		if (length > max_payload)
+			throw std::logic_error("frame too long");
+		payload.resize(length);
+		is.read(&payload[0], length);
+		if (is.gcount() != static_cast<std::streamsize>(length))
+			throw std::logic_error("frame stream ends mid-frame");
+
+		switch (static_cast<Type>(header[4])) {
+		case Type::currency: {
+			std::uint32_t id;
+			if (length <= sizeof id)
+				throw std::logic_error("bad currency frame");
+			std::memcpy(&id, payload.data(), sizeof id);
+			if (id >= max_payload)
+				throw std::logic_error("bad currency frame");
+			if (id >= ids.size()) {
+				ids.resize(id + 1);
+				known.resize(id + 1, false);
+			}
+			ids[id] = symbols::intern(payload.substr(sizeof id));
+			known[id] = true;
+			continue;
+		}
+		case Type::instrument: {
+			Instrument_payload p;
+			if (length != sizeof p)
+				throw std::logic_error("bad instrument frame");
+			std::memcpy(&p, payload.data(), sizeof p);
+			m.type = Type::instrument;
+			m.symbol = { translate(p.base), translate(p.quote) };
+			m.bid = m.ask = 0;
+			return true;
+		}
+		case Type::rate: {
+			Rate_payload p;
+			if (length != sizeof p)
+				throw std::logic_error("bad rate frame");
+			std::memcpy(&p, payload.data(), sizeof p);
+			m.type = Type::rate;
+			m.symbol = { translate(p.base), translate(p.quote) };
+			m.bid = p.bid;
+			m.ask = p.ask;
+			return true;
+		}
+		default:
+			throw std::logic_error("unknown frame type");
+		}
+	}
+}
+
+symbols::Id frame::Reader::translate(std::uint32_t id) const
+{
+	if (id >= known.size() || !known[id])
+		throw std::logic_error("frame refers to an unknown currency");
+	return ids[id];
+}
+
+std::vector<symbols::Instrument> frame::read_instruments(std::istream& is)
+{
+	Reader r (is);
+	Message m;
+	std::vector<symbols::Instrument> out;
+	while (r.next(m)) {
+		if (m.type != Type::instrument)
+			throw std::logic_error("expected an instrument frame");
+		out.push_back(m.symbol);
+	}
+	return out;
+}
+
+std::vector<rates::Rate> frame::read_rates(std::istream& is)
+{
+	Reader r (is);
+	Message m;
+	std::vector<rates::Rate> out;
+	while (r.next(m)) {
+		if (m.type != Type::rate)
+			throw std::logic_error("expected a rate frame");
+		out.emplace_back(m.symbol, m.bid, m.ask);
+	}
+	return out;
+}
@@ -0,0 +1,111 @@
+//          Copyright Andrey Moshbear 2014-2015.
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file LICENSE_1_0.txt or copy at
+//          http://www.boost.org/LICENSE_1_0.txt)
+//
+// Binary framed protocol between the run-* drivers (their -b mode).
+//
+// A stream is a sequence of frames, in native byte order:
+//	uint32 length	of the payload
+//	uint8 type	a Type
+//	payload
+// Payloads:
+//	currency	uint32 id, name		binds a sender id to a currency name
+//	instrument	uint32 base, uint32 quote
+//	rate		uint32 base, uint32 quote, double bid, double ask
+// Ids are the sender's symbols ids; a currency frame precedes the first frame using its id.
+// Readers translate them into their own symbols ids, so an instrument costs no lookup at all
+// after its currencies have been seen once.
+//
+#ifndef FRAME_HH
+#define FRAME_HH
+
+#include <cstdint>
+#include <iosfwd>
+#include <string>
+#include <vector>
+
+#include <symbols.hh>
+#include <rates.hh>
+
+namespace frame {
+
+	enum class Type : std::uint8_t { currency = 1, instrument = 2, rate = 3 };
+
+	// Writer.
+	// Writes instrument and rate frames, and the currency frames they need, to a stream.
+	// Frames go straight into the stream's buffer, which is a ring's own memory when the
+	// stream is a ring::Writer; flush() or destruction flushes the stream.
+	class Writer {
+	public:
+		explicit Writer(std::ostream& os_);
+		~Writer();
+
+		Writer(Writer const&) = delete;
+		Writer& operator= (Writer const&) = delete;
+
+		// Throw: std::runtime_error if the stream fails
+		void instrument(symbols::Instrument instr);
+		void rate(rates::Rate const& r);
+
+		// Throw: std::runtime_error if the stream fails
+		void flush();
+
+	private:
+		std::ostream& os;
+		// currencies sent so far, by symbols::Id
+		std::vector<bool> sent;
+
+		void currency(symbols::Id id);
+		void put(Type t, void const* payload, std::size_t n, void const* tail = nullptr, std::size_t tail_n = 0);
+		// Throw: std::runtime_error if the stream buffer takes less than n bytes
+		void write(char const* data, std::size_t n);
+	};
+
+	// Message.
+	// An instrument or rate frame, with ids translated into the reader's symbols ids;
+	// bid and ask are only set for rates.
+	struct Message {
+		Type type;
+		symbols::Instrument symbol;
+		double bid;
+		double ask;
+	};
+
+	// Reader.
+	// Reads frames from a stream; currency frames are consumed internally.
+	class Reader {
+	public:
+		explicit Reader(std::istream& is_);
+
+		// bool next(Message&).
+		// Read the next instrument or rate frame.
+		//
+		// Arg: Message& m - the frame read
+		// Ret: false at the end of the stream
+		// Throw: std::logic_error if the stream is ill-formed or ends mid-frame
+		bool next(Message& m);
+
+	private:
+		std::istream& is;
+		std::string payload;
+		// sender id -> symbols::Id
+		std::vector<symbols::Id> ids;
+		std::vector<bool> known;
+
+		symbols::Id translate(std::uint32_t id) const;
+	};
+
+	// Whole-stream helpers, for the drivers.
+
+	// Read instrument frames until the end of the stream.
+	// Throw: std::logic_error on other frames
+	std::vector<symbols::Instrument> read_instruments(std::istream& is);
+
+	// Read rate frames until the end of the stream.
+	// Throw: std::logic_error on other frames
+	std::vector<rates::Rate> read_rates(std::istream& is);
+
+}
+
+#endif
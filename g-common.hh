@@ -35,6 +35,7 @@ namespace bgl {
 	using boost::adjacency_list;
 	// graph concepts
 	using boost::add_edge;
+	using boost::add_vertex;
 	using boost::remove_edge;
 	using boost::source;
 	using boost::target;
@@ -64,6 +65,8 @@ namespace bgl {
 	using boost::get;
 	using boost::put;
 	using boost::make_iterator_property_map;
+	using boost::vertex_all;
+	using boost::edge_all;
 	// property tags
 	using boost::edge_property_tag;
 	using boost::property;
@@ -236,6 +239,52 @@ namespace g_common {
 		return out_vertices;
 	}
 
+	// std::vector<Vertex> remove_vertices<G>(G&, std::vector<bool> const&).
+	// Remove a set of vertices, and their edges, from a graph in one pass by rebuilding it.
+	// 	Removing them one at a time costs O(V+E) each with vecS vertex storage.
+	//	Remaining vertices keep their relative order, as do remaining edges, and their properties.
+	//
+	// (TArg): Graph - Graph type; an adjacency_list
+	// Arg: Graph& g - graph to update
+	// Arg: std::vector<bool> const& marked - vertices to remove; marked[v] for each v to remove
+	// Ret: old -> new vertex map, of size num_vertices(g) before removal;
+	//	removed vertices map to graph_traits<Graph>::null_vertex()
+	template <typename Graph>
+	auto remove_vertices(Graph& g, std::vector<bool> const& marked)
+	-> std::vector<typename VE<Graph>::Vertex>
+	{
+		typedef typename VE<Graph>::Vertex Vertex;
+		struct Kept_edge {
+			Vertex u;
+			Vertex v;
+			typename Graph::edge_property_type p;
+		};
+		auto const null = bgl::graph_traits<Graph>::null_vertex();
+
+		std::vector<Vertex> map (bgl::num_vertices(g), null);
+		std::vector<typename Graph::vertex_property_type> vertices;
+		for (Vertex u = 0; u < map.size(); ++u)
+			if (u >= marked.size() || !marked[u]) {
+				map[u] = vertices.size();
+				vertices.push_back(bgl::get(bgl::vertex_all, g, u));
+			}
+		std::vector<Kept_edge> edges;
+		for (auto const& e : util::pair_to_range(bgl::edges(g))) {
+			auto u = map[bgl::source(e, g)];
+			auto v = map[bgl::target(e, g)];
+			if (u != null && v != null)
+				edges.push_back(Kept_edge { u, v, bgl::get(bgl::edge_all, g, e) });
+		}
+
+		// adjacency_list has no move assignment, and its swap copies
+		g.clear();
+		for (auto const& p : vertices)
+			bgl::add_vertex(p, g);
+		for (auto const& e : edges)
+			bgl::add_edge(e.u, e.v, e.p, g);
+		return map;
+	}
+
 	// void to_gv_dotfile<G>(G const&, const char*).
 	// Write a graph to a file specified by path, formatted as a GraphViz Dot file.
 	//
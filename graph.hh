@@ -10,14 +10,14 @@
 #include <string>
 #include <utility>
 
-#include <boost/tokenizer.hpp>
-#include <boost/range/adaptor/reversed.hpp>
 
 #include <d.hh>
 #include <algo.hh>
 #include <c-print.hh>
 #include <util.hh>
 #include <rates.hh>
+#include <symbols.hh>
+#include <snapshot.hh>
 #include <g-common.hh>
 #include <g-rategraph.hh>
 #include <labeled.hh>
@@ -59,15 +59,30 @@ namespace graph {
 	std::vector<std::vector<std::string>::difference_type>
 	remap(std::vector<std::string> const& old_labels, std::vector<std::string> const& new_labels);
 
-	// Modified<G> load_graph_from_rates<G>(labeled::Graph<G>&, Input_description const&).
-	// (Re)build a graph from a vector of rates.
+	// Rate accessors for load_graph_from_rates: call f(symbols::Instrument, bid, ask) for each rate.
+	template <typename F>
+	void for_each_rate(Input_description const& rates, F f)
+	{
+		for (auto const& rate : rates)
+			f(rate.symbol, rate.bid, rate.ask);
+	}
+	template <typename F>
+	void for_each_rate(snapshot::Snapshot const& rates, F f)
+	{
+		for (auto const& rate : rates)
+			f(rates.symbol(rate), rate.bid, rate.ask);
+	}
+
+	// Modified<G> load_graph_from_rates<G,R>(labeled::Graph<G>&, R const&).
+	// (Re)build a graph from a vector of rates, or from a mapped snapshot of them.
 	//
 	// (TArg): G - Graph type
+	// (TArg): R - Input_description or snapshot::Snapshot
 	// Arg: labeled::Graph<G>& lg - output/updated labeled graph
-	// Arg: Input_description const& rates - list of rates describing the graph
+	// Arg: R const& rates - list of rates describing the graph
 	// Ret: modifications done to the graph, contained in a Modified<G>
-	template <typename G>
-	auto load_graph_from_rates(labeled::Graph<G>& lg, Input_description const& rates)
+	template <typename G, typename R>
+	auto load_graph_from_rates(labeled::Graph<G>& lg, R const& rates)
 	-> Modified<G>
 	{
 		typedef typename g_common::VE<G>::Vertex Vertex;
@@ -94,33 +109,35 @@ namespace graph {
 		std::set<Vertex> visited_vertices;
 		std::set<Edge> visited_edges;
 
-		for (auto const& rate : rates) {
-			boost::char_separator<char> sep("_");
-			boost::tokenizer<decltype(sep)> names(rate.instrument, sep);
-			std::vector<std::string> toks;
-			for (auto const& t: names)
-				toks.push_back(t);
-			std::string u (toks[0]);
-			std::string v (toks[1]);
-			typename std::remove_reference<decltype(labels)>::type::difference_type upos, vpos, npos;
-			npos = algo::npos<typename std::remove_reference<decltype(labels)>::type>::value;
-			if ((upos = algo::index_of(labels, u)) == npos) {
-				upos = util::checked_cast<decltype(upos)>(labels.size());
-				labels.push_back(u);
-			}
-			if ((vpos = algo::index_of(labels, v)) == npos) {
-				vpos = util::checked_cast<decltype(vpos)>(labels.size());
-				labels.push_back(v);
+		// symbols::Id -> vertex, or npos
+		typedef typename std::remove_reference<decltype(labels)>::type::difference_type Diff;
+		static const Diff npos = algo::npos<typename std::remove_reference<decltype(labels)>::type>::value;
+		std::vector<Diff> vertex_of (symbols::size(), npos);
+		for (std::size_t i = 0; i < lg.ids.size(); ++i)
+			vertex_of[lg.ids[i]] = util::checked_cast<Diff>(i);
+		auto vertex = [&] (symbols::Id id) {
+			if (id >= vertex_of.size())
+				vertex_of.resize(id + 1, npos);
+			if (vertex_of[id] == npos) {
+				vertex_of[id] = util::checked_cast<Diff>(labels.size());
+				labels.push_back(symbols::name(id));
+				lg.ids.push_back(id);
 			}
-			
+			return vertex_of[id];
+		};
+
+		for_each_rate(rates, [&] (symbols::Instrument symbol, double bid, double ask) {
+			auto upos = vertex(symbol.base);
+			auto vpos = vertex(symbol.quote);
+
 			typedef typename g_common::VE<G> VE;
-			g_rategraph::load_edge_pair(graph, VE::V(upos), VE::V(vpos), rate.ask, rate.bid);
+			g_rategraph::load_edge_pair(graph, VE::V(upos), VE::V(vpos), ask, bid);
 
 			visited_vertices.insert(VE::V(upos));
 			visited_vertices.insert(VE::V(vpos));
 			visited_edges.insert({{{ VE::V(upos), VE::V(vpos) }}});
 			visited_edges.insert({{{ VE::V(vpos), VE::V(upos) }}});
-		}
+		});
 
 		// New = Vis \ Old
 		std::vector<Vertex> new_vertices;
@@ -175,44 +192,31 @@ namespace graph {
 								"<UNADJ> Added edges")
 					  << '\n');
 
+		// edges of deleted vertices go with them
+		std::vector<bool> deleted (bgl::num_vertices(graph), false);
+		for (auto const& del_v : deleted_vertices)
+			deleted[del_v] = true;
 		for (auto const& del_e : deleted_edges)
-			bgl::remove_edge(del_e[0], del_e[1], graph);
-
-		// update indices of new_{vertices,edges} to preserve contiguity of indices
-		// Note: we iterate in reverse direction to simplify adjustment
-		for (auto const& del_v : deleted_vertices | boost::adaptors::reversed) {
-			algo::erase_at(labels, util::checked_cast<typename std::remove_reference<decltype(labels)>::type::difference_type>
-								(del_v));
-			bgl::clear_vertex(del_v, graph);
-			bgl::remove_vertex(del_v, graph);			
-			// reindex new vertices
-			auto where_v = algo::where(new_vertices,
-						[&](Vertex const& u)
-						{ return u > del_v; }
-					);
-			D_print(D_trace, std::cerr,
-				[&]() { std::stringstream s;
-					s << "Delete vertex " << del_v << ": adjust " << where_v.size() << " vertices";
-					return std::string(s.str());
-				}());
-			for (auto& wv : where_v) 
-				--*wv;
-			// reindex new edges
-			auto where_e = algo::where(new_edges,
-						[&](Edge const& e)
-						{ return (e[0] > del_v) || (e[1] > del_v); }
-					);
+			if (!deleted[del_e[0]] && !deleted[del_e[1]])
+				bgl::remove_edge(del_e[0], del_e[1], graph);
+
+		// remove deleted vertices in one pass, then reindex new vertices and edges to preserve contiguity
+		// of indices; new vertices are never deleted ones
+		if (deleted_vertices.size()) {
+			auto map = g_common::remove_vertices(graph, deleted);
+			algo::erase_marked(labels, deleted);
+			algo::erase_marked(lg.ids, deleted);
 			D_print(D_trace, std::cerr,
 				[&]() { std::stringstream s;
-					s << "Delete vertex " << del_v << ": adjust " << where_v.size() << " edges";
+					s << "Delete " << deleted_vertices.size() << " vertices: adjust "
+					  << new_vertices.size() << " vertices and " << new_edges.size() << " edges";
 					return std::string(s.str());
 				}());
-			for (auto& we : where_e) {
-				auto& ee = *we;
-				if (ee[0] > del_v)
-					--ee[0];
-				if (ee[1] > del_v)
-					--ee[1];
+			for (auto& v : new_vertices)
+				v = map[v];
+			for (auto& e : new_edges) {
+				e[0] = map[e[0]];
+				e[1] = map[e[1]];
 			}
 		}
 		D_eval(D_trace,
@@ -233,6 +237,62 @@ namespace graph {
 				   };			
 	}
 
+	// Updater<G>.
+	// Apply single rate updates to a labeled graph in place, e.g. ticks from a quote stream.
+	// An update for a new instrument adds its edges, and its vertices if need be; nothing is removed.
+	//
+	// TArg: G - Graph type
+	template <typename G>
+	class Updater
+	{
+		typedef typename g_common::VE<G>::Vertex Vertex;
+		static constexpr Vertex npos = static_cast<Vertex>(-1);
+
+	public:
+		explicit Updater(labeled::Graph<G>& lg_)
+		: lg(lg_)
+		{
+			for (std::size_t i = 0; i < lg.ids.size(); ++i) {
+				if (lg.ids[i] >= vertex_of.size())
+					vertex_of.resize(lg.ids[i] + 1, npos);
+				vertex_of[lg.ids[i]] = util::checked_cast<Vertex>(i);
+			}
+		}
+
+		// void operator()(symbols::Instrument, double, double).
+		// Set the rates of an instrument.
+		//
+		// Arg: symbols::Instrument symbol - the instrument
+		// Arg: double bid - its bid
+		// Arg: double ask - its ask
+		void operator()(symbols::Instrument symbol, double bid, double ask)
+		{
+			auto u = vertex(symbol.base);
+			auto v = vertex(symbol.quote);
+			g_rategraph::load_edge_pair(lg.graph, u, v, ask, bid);
+		}
+
+	private:
+		labeled::Graph<G>& lg;
+		// symbols::Id -> vertex, or npos
+		std::vector<Vertex> vertex_of;
+
+		Vertex vertex(symbols::Id id)
+		{
+			if (id >= vertex_of.size())
+				vertex_of.resize(id + 1, npos);
+			if (vertex_of[id] == npos) {
+				// load_edge_pair adds the vertex along with its first edge
+				vertex_of[id] = util::checked_cast<Vertex>(lg.labels.size());
+				lg.labels.push_back(symbols::name(id));
+				lg.ids.push_back(id);
+			}
+			return vertex_of[id];
+		}
+	};
+	template <typename G>
+	constexpr typename Updater<G>::Vertex Updater<G>::npos;
+
 	// Rated_path<G> best_path<G>(labeled::Graph<G> const&, size_t max_iterations = -1)
 	// Compute the best path, subject to an optional specified iteration limit.
 	//	0th iteration searches for initial 3-cycle and successive iterations build iteratively from that.
@@ -254,6 +314,11 @@ namespace graph {
 		g_rategraph::Rated_path<G> rp_out;
 		size_t c_iter = 0;
 		rp_out = g_rategraph::find_initial_simplex(lg_in.graph);
+		// No profitable 3-cycle: nothing to expand
+		if (rp_out.path.empty()) {
+			D_print(D_info, std::cerr, "No initial simplex");
+			return rp_out;
+		}
 		D_print(D_info, std::cerr, [&] {
 			std::stringstream s;
 			s << "Iteration " << c_iter;
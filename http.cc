@@ -4,101 +4,1471 @@
 //          http://www.boost.org/LICENSE_1_0.txt)
 //
 // Common HTTP bits.
-// Linking depdendencies: -lboost_system
+// Linking depdendencies: -lboost_system -lpthread -lz
 
 
 // parts from http://www.boost.org/doc/html/boost_asio/example/cpp03/http/client/sync_client.cpp
+// parts from http://www.boost.org/doc/html/boost_asio/example/cpp03/http/client/async_client.cpp
 
+#include <algorithm>
+#include <cctype>
+#include <cstddef>
+#include <cstdlib>
+#include <cstring>
 #include <iostream>
-#include <istream>
 #include <ostream>
 #include <array>
+#include <atomic>
+#include <chrono>
+#include <exception>
+#include <functional>
+#include <future>
+#include <map>
+#include <memory>
+#include <mutex>
 #include <string>
 #include <stdexcept>
 #include <sstream>
+#include <thread>
+#include <utility>
 #include <vector>
 #include <boost/asio.hpp>
+#include <boost/utility/string_ref.hpp>
+
+extern "C" {
+#include <zlib.h>
+}
 
 #include <http.hh>
 
 using boost::asio::ip::tcp;
+using boost::system::error_code;
 
-std::string http::query(std::array<std::string, 3> uri) {
+namespace {
+
+	typedef std::unique_ptr<tcp::socket> Socket_ptr;
+
+	// Response framing, as determined by the response headers.
+	struct Framing {
+		// body is delimited by Content-Length
+		bool has_length = false;
+		std::size_t length = 0;
+		// body is sent with Transfer-Encoding: chunked
+		bool chunked = false;
+		// body bytes left in the message or current chunk
+		std::size_t remaining = 0;
+		// connection may be reused after the body
+		bool keep_alive = true;
+	};
+
+	// Response parsing phases
+	enum class Phase { headers, length_body, eof_body, chunk_size, chunk_data, chunk_end, trailer };
+
+	// Case-insensitive comparison of a view against a lowercase literal
+	bool iequals(boost::string_ref s, char const* lower)
+	{
+		auto n = std::strlen(lower);
+		if (s.size() != n)
+			return false;
+		for (std::size_t i = 0; i < n; ++i)
+			if (std::tolower(static_cast<unsigned char>(s[i])) != lower[i])
+				return false;
+		return true;
+	}
+
+	// Case-insensitive substring search of a lowercase literal
+	bool icontains(boost::string_ref s, char const* lower)
+	{
+		auto n = std::strlen(lower);
+		for (std::size_t i = 0; i + n <= s.size(); ++i)
+			if (iequals(s.substr(i, n), lower))
+				return true;
+		return false;
+	}
+
+	// Content-Encoding byte counters
+	struct {
+		std::atomic<unsigned long long> responses { 0 };
+		std::atomic<unsigned long long> encoded_responses { 0 };
+		std::atomic<unsigned long long> wire_bytes { 0 };
+		std::atomic<unsigned long long> decoded_bytes { 0 };
+	} encoding_counters;
+
+	// Atomic_histogram.
+	// Lock-free recorder behind http::Histogram; concurrent add()s only contend on
+	// the cache lines of the counters they touch.
+	class Atomic_histogram
+	{
+	public:
+		void add(unsigned long long v)
+		{
+			std::size_t i = 0;
+			while (i + 1 < http::Histogram::buckets && (v >> i))
+				++i;
+			counts[i].fetch_add(1, std::memory_order_relaxed);
+			count.fetch_add(1, std::memory_order_relaxed);
+			sum.fetch_add(v, std::memory_order_relaxed);
+			auto m = max.load(std::memory_order_relaxed);
+			while (v > m && !max.compare_exchange_weak(m, v, std::memory_order_relaxed))
+				;
+		}
+
+		template <typename Duration>
+		void add_duration(Duration d)
+		{
+			auto us = std::chrono::duration_cast<std::chrono::microseconds>(d).count();
+			add(us > 0 ? static_cast<unsigned long long>(us) : 0);
+		}
+
+		http::Histogram snapshot() const
+		{
+			http::Histogram h;
+			for (std::size_t i = 0; i < http::Histogram::buckets; ++i)
+				h.counts[i] = counts[i].load(std::memory_order_relaxed);
+			h.count = count.load(std::memory_order_relaxed);
+			h.sum = sum.load(std::memory_order_relaxed);
+			h.max = max.load(std::memory_order_relaxed);
+			return h;
+		}
+	private:
+		std::array<std::atomic<unsigned long long>, http::Histogram::buckets> counts {{ }};
+		std::atomic<unsigned long long> count { 0 };
+		std::atomic<unsigned long long> sum { 0 };
+		std::atomic<unsigned long long> max { 0 };
+	};
+
+	// Per-phase exchange timings
+	struct {
+		Atomic_histogram resolve;
+		Atomic_histogram connect;
+		Atomic_histogram ttfb;
+		Atomic_histogram body;
+		Atomic_histogram bytes;
+	} phase_histograms;
+
+	// Inflater.
+	// Streaming zlib decoder for gzip and deflate content codings.
+	// "deflate" is meant to be zlib-wrapped, but some servers send raw deflate; the first
+	// two bytes decide which, once, however the body is split into pieces.
+	class Inflater
+	{
+	public:
+		Inflater(bool deflate_)
+		: deflate(deflate_), nhead(0), ended(false)
+		{
+			init(15 + 32); // zlib or gzip, detected from the header
+		}
+		~Inflater()
+		{
+			inflateEnd(&zs);
+		}
+		Inflater(Inflater const&) = delete;
+		Inflater& operator= (Inflater const&) = delete;
+
+		// void feed<F>(char const*, size_t, F out).
+		// Decode a piece of the encoded body; `out(char const*, size_t)` receives the output.
+		template <typename F>
+		void feed(char const* data, std::size_t n, F out)
+		{
+			if (nhead < sizeof head) {
+				while (nhead < sizeof head && n) {
+					head[nhead++] = static_cast<unsigned char>(*data++);
+					--n;
+				}
+				if (nhead < sizeof head)
+					return;
+				if (deflate && !wrapped()) {
+					inflateEnd(&zs);
+					init(-15);
+				}
+				decode(reinterpret_cast<char const*>(head), sizeof head, out);
+			}
+			decode(data, n, out);
+		}
+
+		// Whether the encoded stream was complete
+		bool complete() const
+		{ return ended; }
+
+	private:
+		z_stream zs;
+		bool deflate;
+		// the first bytes of the stream, held back until the format is known
+		unsigned char head[2];
+		std::size_t nhead;
+		bool ended;
+		char window[16384];
+
+		void init(int window_bits)
+		{
+			zs = z_stream();
+			if (inflateInit2(&zs, window_bits) != Z_OK)
+				throw std::runtime_error("inflateInit2 failed");
+		}
+
+		// Whether the stream starts with a gzip or zlib header (RFC 1952, 1950)
+		bool wrapped() const
+		{
+			if (head[0] == 0x1f && head[1] == 0x8b)
+				return true;
+			return (head[0] & 0x0f) == 8 && (head[0] >> 4) <= 7 && ((head[0] << 8) | head[1]) % 31 == 0;
+		}
+
+		template <typename F>
+		void decode(char const* data, std::size_t n, F out)
+		{
+			if (ended || !n)
+				return;
+			zs.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(data));
+			zs.avail_in = static_cast<uInt>(n);
+			do {
+				zs.next_out = reinterpret_cast<Bytef*>(window);
+				zs.avail_out = sizeof window;
+				int rc = inflate(&zs, Z_NO_FLUSH);
+				if (rc != Z_OK && rc != Z_STREAM_END && rc != Z_BUF_ERROR)
+					throw std::invalid_argument(std::string("content decoding error: ")
+								    + (zs.msg ? zs.msg : "zlib"));
+				auto produced = sizeof window - zs.avail_out;
+				if (produced)
+					out(window, produced);
+				if (rc == Z_STREAM_END) {
+					ended = true;
+					return;
+				}
+			} while (zs.avail_in > 0 || zs.avail_out == 0);
+		}
+	};
+
+	boost::string_ref trim(boost::string_ref s)
+	{
+		while (!s.empty() && std::isspace(static_cast<unsigned char>(s.front())))
+			s.remove_prefix(1);
+		while (!s.empty() && std::isspace(static_cast<unsigned char>(s.back())))
+			s.remove_suffix(1);
+		return s;
+	}
+
+	typedef std::vector<tcp::endpoint> Endpoints;
+	typedef std::chrono::steady_clock Clock;
+
+	// Dns_cache.
+	// Process-wide cache of resolved endpoints, keyed by domain and service.
+	//
+	// A fresh entry is returned as is. An expired entry is still returned, so that the
+	// resolver stays off the request path, and a background refresh is started on the
+	// caller's io_service; should the refresh fail, the cached endpoints are kept.
+	// A TTL of zero disables caching.
+	class Dns_cache
+	{
+	public:
+		Dns_cache()
+		: ttl(std::chrono::seconds(60))
+		{ }
+
+		void set_ttl(Clock::duration t)
+		{
+			std::lock_guard<std::mutex> lock(mtx);
+			ttl = t;
+			if (ttl == Clock::duration::zero())
+				entries.clear();
+		}
+
+		// bool lookup(io_service&, std::string const& host, std::string const& service, Endpoints&).
+		// Fetch cached endpoints for host:service, if any.
+		//
+		// Ret: true on a hit, in which case `out` is filled
+		bool lookup(boost::asio::io_service& io, std::string const& host, std::string const& service,
+			    Endpoints& out)
+		{
+			bool refresh = false;
+			{
+				std::lock_guard<std::mutex> lock(mtx);
+				auto it = entries.find(key(host, service));
+				if (it == entries.end()) {
+					++stats.misses;
+					return false;
+				}
+				++stats.hits;
+				out = it->second.endpoints;
+				if (Clock::now() >= it->second.expires && !it->second.refreshing) {
+					it->second.refreshing = true;
+					refresh = true;
+				}
+			}
+			if (refresh)
+				start_refresh(io, host, service);
+			return true;
+		}
+
+		void store(std::string const& host, std::string const& service, Endpoints const& endpoints)
+		{
+			std::lock_guard<std::mutex> lock(mtx);
+			if (ttl == Clock::duration::zero() || endpoints.empty())
+				return;
+			Entry& e (entries[key(host, service)]);
+			e.endpoints = endpoints;
+			e.expires = Clock::now() + ttl;
+			e.refreshing = false;
+		}
+
+		// Drop an entry whose endpoints could not be connected to.
+		void invalidate(std::string const& host, std::string const& service)
+		{
+			std::lock_guard<std::mutex> lock(mtx);
+			entries.erase(key(host, service));
+		}
+
+		http::Dns_stats counters()
+		{
+			http::Dns_stats s;
+			s.hits = stats.hits;
+			s.misses = stats.misses;
+			s.refreshes = stats.refreshes;
+			s.refresh_failures = stats.refresh_failures;
+			return s;
+		}
+
+	private:
+		struct Entry {
+			Endpoints endpoints;
+			Clock::time_point expires;
+			bool refreshing;
+		};
+		std::mutex mtx;
+		std::map<std::string, Entry> entries;
+		Clock::duration ttl;
+		struct {
+			std::atomic<unsigned long long> hits { 0 };
+			std::atomic<unsigned long long> misses { 0 };
+			std::atomic<unsigned long long> refreshes { 0 };
+			std::atomic<unsigned long long> refresh_failures { 0 };
+		} stats;
+
+		static std::string key(std::string const& host, std::string const& service)
+		{
+			return host + ':' + service;
+		}
+
+		void start_refresh(boost::asio::io_service& io, std::string const& host, std::string const& service)
+		{
+			++stats.refreshes;
+			auto resolver (std::make_shared<tcp::resolver>(io));
+			tcp::resolver::query query(host, service);
+			resolver->async_resolve(query,
+				[this, resolver, host, service] (error_code error, tcp::resolver::iterator it) {
+					if (!error) {
+						store(host, service, Endpoints(it, tcp::resolver::iterator()));
+						return;
+					}
+					// Keep serving the old endpoints; the next lookup retries.
+					++stats.refresh_failures;
+					std::lock_guard<std::mutex> lock(mtx);
+					auto e = entries.find(key(host, service));
+					if (e != entries.end())
+						e->second.refreshing = false;
+				});
+		}
+	};
+
+	Dns_cache& dns_cache()
+	{
+		static Dns_cache cache;
+		return cache;
+	}
+
+	// Address to connect to instead of the request's domain, from
+	// CURREX_HTTP_ENDPOINT=host[:port]; used to point the client at a stand-in server.
+	// The Host header still names the original domain.
+	struct Endpoint_override {
+		bool set = false;
+		std::string host;
+		std::string service;
+	};
+
+	Endpoint_override const& endpoint_override()
+	{
+		static Endpoint_override const o ([] {
+			Endpoint_override e;
+			auto env = std::getenv("CURREX_HTTP_ENDPOINT");
+			if (!env || !*env)
+				return e;
+			std::string ep (env);
+			auto colon = ep.rfind(':');
+			e.set = true;
+			e.host = ep.substr(0, colon);
+			e.service = (colon == std::string::npos) ? "http" : ep.substr(colon + 1);
+			return e;
+		}());
+		return o;
+	}
+
+	// Latency_log.
+	// Latencies of the most recent successful calls of a client, and its call counters.
+	// Not synchronized; guarded by the owning pool's mutex.
+	class Latency_log
+	{
+	public:
+		static std::size_t const window = 256;
+
+		unsigned long long calls = 0;
+		unsigned long long timeouts = 0;
+		unsigned long long hedges = 0;
+		unsigned long long hedge_wins = 0;
+
+		void record(Clock::duration first_byte, Clock::duration total)
+		{
+			if (ttfb.size() < window) {
+				ttfb.push_back(first_byte);
+				whole.push_back(total);
+			} else {
+				ttfb[next] = first_byte;
+				whole[next] = total;
+			}
+			next = (next + 1) % window;
+		}
+
+		std::size_t samples() const
+		{ return ttfb.size(); }
+
+		// Clock::duration ttfb_percentile(double p) const.
+		// Ret: p-th percentile (0 < p <= 100) of time to first byte, or zero without samples
+		Clock::duration ttfb_percentile(double p) const
+		{ return percentile(ttfb, p); }
+
+		Clock::duration total_percentile(double p) const
+		{ return percentile(whole, p); }
+
+	private:
+		// time to first response byte, and to the end of the body
+		std::vector<Clock::duration> ttfb, whole;
+		// slot to overwrite once the window is full
+		std::size_t next = 0;
+
+		static Clock::duration percentile(std::vector<Clock::duration> v, double p)
+		{
+			if (v.empty())
+				return Clock::duration::zero();
+			auto rank = static_cast<std::size_t>(p / 100 * v.size());
+			auto nth = v.begin() + std::min(rank, v.size() - 1);
+			std::nth_element(v.begin(), nth, v.end());
+			return *nth;
+		}
+	};
+}
+
+// Writer side of Response: the parser in Exchange works on the buffer in place.
+struct http::detail::Response_access {
+	static char* data(Response& r)
+	{ return r.buf.get(); }
+	static std::size_t& size(Response& r)
+	{ return r.size; }
+	static std::size_t& status_end(Response& r)
+	{ return r.status_end; }
+	static std::size_t& headers_end(Response& r)
+	{ return r.headers_end; }
+	static std::size_t& body_end(Response& r)
+	{ return r.body_end; }
+	static unsigned& code(Response& r)
+	{ return r.code; }
+	static bool& encoded(Response& r)
+	{ return r.encoded; }
+	static std::string& decoded(Response& r)
+	{ return r.decoded; }
+
+	// Make room for at least n more bytes.
+	static void reserve(Response& r, std::size_t n)
+	{
+		if (r.cap - r.size >= n)
+			return;
+		auto cap = std::max(std::max(r.cap * 2, r.size + n), std::size_t(8192));
+		std::unique_ptr<char[]> buf (new char[cap]);
+		if (r.size)
+			std::memcpy(buf.get(), r.buf.get(), r.size);
+		r.buf = std::move(buf);
+		r.cap = cap;
+	}
 
-	// things following from here are more or less copy paste from
-	// linked boost tutorial, excepting exceptions and json parsing
+	// Unfilled part of the buffer
+	static boost::asio::mutable_buffers_1 tail(Response& r)
+	{ return boost::asio::buffer(r.buf.get() + r.size, r.cap - r.size); }
+};
 
+struct http::detail::Pool {
 	boost::asio::io_service io_service;
+	std::unique_ptr<boost::asio::io_service::work> work;
+	std::thread worker;
+	// the I/O thread's id, for in_io_thread; set before the thread runs anything
+	std::atomic<std::thread::id> worker_id;
+	std::once_flag started;
+	std::size_t max_idle;
+	std::mutex mtx;
+	// idle connections, keyed by protocol and domain
+	std::map<std::string, std::vector<Socket_ptr>> idle;
+	// call time limits, and latency record; guarded by mtx
+	Timing timing;
+	Latency_log latency;
+
+	Pool(std::size_t max_idle_)
+	: max_idle(max_idle_)
+	{ }
+
+	~Pool()
+	{
+		if (worker.joinable()) {
+			work.reset();
+			io_service.stop();
+			worker.join();
+		}
+	}
+
+	// Start the I/O thread, if it isn't running yet.
+	void start()
+	{
+		std::call_once(started, [this] {
+			work.reset(new boost::asio::io_service::work(io_service));
+			worker = std::thread([this] {
+				worker_id.store(std::this_thread::get_id());
+				run();
+			});
+		});
+	}
+
+	void run()
+	{
+		for (;;) {
+			try {
+				io_service.run();
+				return;
+			} catch (std::exception const& e) {
+				std::cerr << "http: handler threw: " << e.what() << std::endl;
+			}
+		}
+	}
+
+	bool in_io_thread()
+	{
+		return worker_id.load() == std::this_thread::get_id();
+	}
+
+	static std::string key(Uri const& uri)
+	{
+		return uri[0] + "://" + uri[1];
+	}
+
+	// Check out an idle connection, if there is one.
+	Socket_ptr checkout(std::string const& k)
+	{
+		std::lock_guard<std::mutex> lock(mtx);
+		auto it = idle.find(k);
+		if (it == idle.end() || it->second.empty())
+			return Socket_ptr();
+		Socket_ptr s (std::move(it->second.back()));
+		it->second.pop_back();
+		return s;
+	}
+
+	// Return a connection to the idle pool; excess connections are closed.
+	void checkin(std::string const& k, Socket_ptr s)
+	{
+		std::lock_guard<std::mutex> lock(mtx);
+		auto& conns = idle[k];
+		if (conns.size() < max_idle)
+			conns.push_back(std::move(s));
+	}
+};
+
+namespace {
+
+	typedef http::detail::Response_access Access;
+
+	class Exchange;
+
+	// Call.
+	// One query as seen by the caller: a primary exchange, possibly a hedged duplicate of it,
+	// and the call's deadline. Lives on the I/O thread.
+	//
+	// The first exchange to receive response bytes wins the call and the other one is
+	// dropped; from then on only the winner reaches the consumer or the Response. A call
+	// which fails before any exchange has been answered reports the failure of the last
+	// exchange to fail.
+	class Call : public std::enable_shared_from_this<Call>
+	{
+	public:
+		Call(http::detail::Pool& p, http::Uri const& u, http::Validators v,
+		     http::Body_consumer c, http::Response* r, http::Completion d)
+		: pool(p), uri(u), validators(std::move(v)), sink(std::move(c)), external(r), done(std::move(d)),
+		  deadline_timer(p.io_service), hedge_timer(p.io_service), hedged(false), winner(nullptr),
+		  failures(0), finished(false)
+		{
+			std::lock_guard<std::mutex> lock(pool.mtx);
+			timing = pool.timing;
+			if (timing.hedge_percentile > 0 && pool.latency.samples() >= timing.hedge_min_samples)
+				hedge_after = pool.latency.ttfb_percentile(timing.hedge_percentile);
+		}
+
+		void start();
+
+		http::detail::Pool& pool;
+		http::Uri const uri;
+		http::Validators const validators;
+		http::Body_consumer const sink;
+
+		// Exchange callbacks
+		void answered(Exchange* e);
+		void failed(Exchange* e, std::exception_ptr error);
+		void succeeded(Exchange* e);
+
+	private:
+		http::Response* external;
+		http::Completion done;
+		http::Timing timing;
+		Clock::time_point begin;
+		Clock::duration first_byte;
+		Clock::duration hedge_after = Clock::duration::zero();
+		boost::asio::steady_timer deadline_timer;
+		boost::asio::steady_timer hedge_timer;
+		bool hedged;
+		std::vector<std::shared_ptr<Exchange>> attempts;
+		Exchange* winner;
+		std::size_t failures;
+		bool finished;
+
+		void launch();
+		void on_deadline(error_code error);
+		void on_hedge(error_code error);
+		void complete(std::exception_ptr error);
+	};
+
+	// Exchange.
+	// A single asynchronous request/response exchange on a pooled connection.
+	// Kept alive by the shared_ptr captured in each pending handler.
+	//
+	// Socket reads go straight into the tail of a Response buffer, which is parsed in place.
+	// With a Body_consumer, body pieces are handed over as they are decoded and then
+	// dropped from the buffer; without one, the decoded body is kept in the Response.
+	class Exchange : public std::enable_shared_from_this<Exchange>
+	{
+	public:
+		// Arg: std::shared_ptr<Call> c - the call this exchange is an attempt at
+		// Arg: http::Response* r - response to read into; null to use a private one
+		Exchange(std::shared_ptr<Call> c, http::Response* r)
+		: call(std::move(c)), pool(call->pool), uri(call->uri), key(http::detail::Pool::key(uri)),
+		  sink(call->sink), owned(r ? nullptr : new http::Response), response(r ? *r : *owned),
+		  validators(call->validators),
+		  host(endpoint_override().set ? endpoint_override().host : uri[1]),
+		  service(endpoint_override().set ? endpoint_override().service : uri[0]),
+		  reused(false), resolver(pool.io_service), cached_endpoints(false),
+		  phase(Phase::headers), cursor(0), answered(false), cancelled(false)
+		{ }
+
+		void start()
+		{
+			// Form the request. HTTP/1.1 connections are persistent by default; the
+			// response is delimited either by Content-Length or by chunked encoding.
+			std::ostream request_stream(&request);
+			request_stream << "GET " << uri[2] << " HTTP/1.1\r\n";
+			request_stream << "Host: " << uri[1] << "\r\n";
+			request_stream << "Accept: */*\r\n";
+			request_stream << "Accept-Encoding: gzip, deflate\r\n";
+			if (!validators.etag.empty())
+				request_stream << "If-None-Match: " << validators.etag << "\r\n";
+			if (!validators.last_modified.empty())
+				request_stream << "If-Modified-Since: " << validators.last_modified << "\r\n";
+			request_stream << "Connection: keep-alive\r\n\r\n";
+
+			response.clear();
+			socket = pool.checkout(key);
+			reused = static_cast<bool>(socket);
+			if (socket)
+				send();
+			else
+				connect();
+		}
+
+		// Abandon the exchange: no handler of it runs any more, and its connection is closed.
+		void cancel()
+		{
+			cancelled = true;
+			resolver.cancel();
+			error_code ignored;
+			if (socket)
+				socket->close(ignored);
+		}
+
+		http::Response& result()
+		{ return response; }
+
+	private:
+		std::shared_ptr<Call> call;
+		http::detail::Pool& pool;
+		http::Uri const& uri;
+		std::string key;
+		http::Body_consumer const& sink;
+		std::unique_ptr<http::Response> owned;
+		http::Response& response;
+		// validators of a conditional request; both empty otherwise
+		http::Validators const& validators;
+		// where to connect to: the request's domain and protocol, unless overridden
+		std::string host;
+		std::string service;
+		Socket_ptr socket;
+		bool reused;
+		tcp::resolver resolver;
+		Endpoints endpoints;
+		bool cached_endpoints;
+		boost::asio::streambuf request;
+		Framing framing;
+		Phase phase;
+		// offset of the first unparsed byte in the response buffer
+		std::size_t cursor;
+		// content decoder, if the body is encoded
+		std::unique_ptr<Inflater> inflater;
+		// response bytes have been received
+		bool answered;
+		bool cancelled;
+		// phase timestamps: start of resolution or connection setup, request sent, first byte
+		Clock::time_point t_resolve, t_connect, t_sent, t_first;
+		// bytes read from the socket
+		std::size_t received = 0;
+
+		// Wrap a member continuation so that exceptions thrown from it fail the exchange.
+		template <typename... Args>
+		std::function<void(Args...)> step(void (Exchange::*f)(Args...))
+		{
+			auto self (shared_from_this());
+			return [self, f] (Args... args) {
+				if (self->cancelled)
+					return;
+				try {
+					((*self).*f)(args...);
+				} catch (...) {
+					self->fail(std::current_exception());
+				}
+			};
+		}
+
+		void fail(std::exception_ptr e)
+		{
+			socket.reset();
+			call->failed(this, e);
+		}
+
+		void check(error_code const& error)
+		{
+			if (error)
+				throw boost::system::system_error(error);
+		}
+
+		void connect()
+		{
+			// Get a list of endpoints corresponding to the server name, preferably from cache.
+			cached_endpoints = dns_cache().lookup(pool.io_service, host, service, endpoints);
+			if (cached_endpoints)
+				return start_connect();
+			t_resolve = Clock::now();
+			tcp::resolver::query query(host, service);
+			resolver.async_resolve(query, step(&Exchange::on_resolve));
+		}
+
+		void on_resolve(error_code error, tcp::resolver::iterator endpoint_iterator)
+		{
+			check(error);
+			phase_histograms.resolve.add_duration(Clock::now() - t_resolve);
+			endpoints.assign(endpoint_iterator, tcp::resolver::iterator());
+			dns_cache().store(host, service, endpoints);
+			start_connect();
+		}
+
+		void start_connect()
+		{
+			// Try each endpoint until we successfully establish a connection.
+			socket.reset(new tcp::socket(pool.io_service));
+			t_connect = Clock::now();
+			boost::asio::async_connect(*socket, endpoints.begin(), endpoints.end(),
+				step(&Exchange::on_connect));
+		}
+
+		void on_connect(error_code error, Endpoints::iterator)
+		{
+			// Cached endpoints which can't be connected to are likely outdated
+			if (error && cached_endpoints)
+				dns_cache().invalidate(host, service);
+			check(error);
+			phase_histograms.connect.add_duration(Clock::now() - t_connect);
+			socket->set_option(tcp::no_delay(true));
+			send();
+		}
+
+		void send()
+		{
+			t_sent = Clock::now();
+			boost::asio::async_write(*socket, request.data(), step(&Exchange::on_write));
+		}
+
+		// A pooled connection may have been closed by the server while idle; this shows up
+		// as a failure before any response bytes arrive, in which case we reconnect once.
+		bool retry_stale(error_code const& error)
+		{
+			if (!error || !reused || Access::size(response) > 0)
+				return false;
+			reused = false;
+			socket.reset();
+			connect();
+			return true;
+		}
+
+		void on_write(error_code error, std::size_t)
+		{
+			if (retry_stale(error))
+				return;
+			check(error);
+			read_more();
+		}
+
+		void read_more()
+		{
+			// Streamed body bytes have been handed over already; keep only what's unparsed.
+			if (sink && phase != Phase::headers) {
+				auto& size = Access::size(response);
+				auto body = Access::headers_end(response);
+				if (cursor > body) {
+					std::memmove(Access::data(response) + body, Access::data(response) + cursor, size - cursor);
+					size -= cursor - body;
+					cursor = body;
+				}
+				Access::body_end(response) = body;
+			}
+			Access::reserve(response, 4096);
+			socket->async_read_some(Access::tail(response), step(&Exchange::on_read));
+		}
+
+		void on_read(error_code error, std::size_t n)
+		{
+			Access::size(response) += n;
+			received += n;
+			if (n && !answered) {
+				answered = true;
+				t_first = Clock::now();
+				phase_histograms.ttfb.add_duration(t_first - t_sent);
+				call->answered(this);
+			}
+			if (error == boost::asio::error::eof && phase == Phase::eof_body) {
+				parse();
+				return finish();
+			}
+			if (retry_stale(error))
+				return;
+			check(error);
+			if (parse())
+				return finish();
+			read_more();
+		}
+
+		// Find CRLF at or after offset `from` in the received data.
+		std::size_t find_crlf(std::size_t from)
+		{
+			boost::string_ref received (Access::data(response), Access::size(response));
+			auto pos = received.substr(from).find("\r\n");
+			return pos == boost::string_ref::npos ? pos : from + pos;
+		}
+
+		// Parse as much of the received data as possible.
+		// Ret: true once the response is complete
+		bool parse()
+		{
+			auto const npos = boost::string_ref::npos;
+			for (;;) {
+				auto available = Access::size(response) - cursor;
+				switch (phase) {
+				case Phase::headers: {
+					boost::string_ref received (Access::data(response), Access::size(response));
+					auto end = received.find("\r\n\r\n");
+					if (end == npos)
+						return false;
+					parse_headers(end + 4);
+					break;
+				}
+				case Phase::length_body:
+					framing.remaining -= emit(std::min(framing.remaining, available));
+					return framing.remaining == 0;
+				case Phase::eof_body:
+					emit(available);
+					return false;
+				// Chunked transfer decoding: size line, data, CRLF; repeated until a zero size,
+				// after which come trailers terminated by a blank line.
+				// Chunk data is decoded as it arrives rather than once the chunk is complete.
+				case Phase::chunk_size: {
+					auto eol = find_crlf(cursor);
+					if (eol == npos)
+						return false;
+					// chunk extensions are ignored
+					std::string line (Access::data(response) + cursor, eol - cursor);
+					char* end;
+					framing.remaining = std::strtoul(line.c_str(), &end, 16);
+					if (end == line.c_str())
+						throw std::logic_error("ill-formed HTTP chunk size");
+					cursor = eol + 2;
+					phase = framing.remaining ? Phase::chunk_data : Phase::trailer;
+					break;
+				}
+				case Phase::chunk_data:
+					framing.remaining -= emit(std::min(framing.remaining, available));
+					if (framing.remaining)
+						return false;
+					phase = Phase::chunk_end;
+					break;
+				case Phase::chunk_end:
+					if (available < 2)
+						return false;
+					if (find_crlf(cursor) != cursor)
+						throw std::logic_error("ill-formed HTTP chunk");
+					cursor += 2;
+					phase = Phase::chunk_size;
+					break;
+				case Phase::trailer: {
+					auto eol = find_crlf(cursor);
+					if (eol == npos)
+						return false;
+					bool blank = (eol == cursor);
+					cursor = eol + 2;
+					if (blank)
+						return true;
+					break;
+				}
+				}
+			}
+		}
+
+		// Check the status line and process the header block ending at offset `end`.
+		void parse_headers(std::size_t end)
+		{
+			char const* data = Access::data(response);
+			boost::string_ref block (data, end - 2);
+			auto status_end = block.find("\r\n");
+			boost::string_ref status_line (block.substr(0, status_end));
+
+			// Check that response is OK.
+			auto sp = status_line.find(' ');
+			auto http_version = status_line.substr(0, sp);
+			if (sp == boost::string_ref::npos || http_version.substr(0, 5) != "HTTP/")
+				throw std::logic_error("ill-formed HTTP response");
+			std::string code (status_line.substr(sp + 1, 3).to_string());
+			char* code_end;
+			unsigned int status_code = static_cast<unsigned int>(std::strtoul(code.c_str(), &code_end, 10));
+			if (code_end == code.c_str())
+				throw std::logic_error("ill-formed HTTP response");
+			Access::status_end(response) = status_end;
+			Access::headers_end(response) = end;
+			Access::body_end(response) = end;
+			Access::code(response) = status_code;
+			cursor = end;
+			// Not Modified is only an expected outcome of a conditional request
+			bool not_modified = (status_code == 304)
+				&& !(validators.etag.empty() && validators.last_modified.empty());
+			if (status_code != 200 && !not_modified)
+				throw std::invalid_argument(
+					([status_code] {
+						std::stringstream s;
+						s << "HTTP status code: "; s << status_code; s << "\n";
+						std::string ss(s.str());
+						return ss;
+					})());
+
+			// Process the response headers.
+			framing.keep_alive = (http_version != "HTTP/1.0");
+			auto headers = block.substr(status_end + 2);
+			while (!headers.empty()) {
+				auto eol = headers.find("\r\n");
+				auto header = headers.substr(0, eol);
+				headers = (eol == boost::string_ref::npos) ? boost::string_ref() : headers.substr(eol + 2);
+				auto colon = header.find(':');
+				if (colon == boost::string_ref::npos)
+					continue;
+				auto name = header.substr(0, colon);
+				auto value = trim(header.substr(colon + 1));
+				if (iequals(name, "content-length")) {
+					framing.has_length = true;
+					framing.length = std::strtoul(value.to_string().c_str(), nullptr, 10);
+				} else if (iequals(name, "transfer-encoding")) {
+					framing.chunked = icontains(value, "chunked");
+				} else if (iequals(name, "content-encoding")) {
+					if (iequals(value, "gzip") || iequals(value, "x-gzip"))
+						inflater.reset(new Inflater(false));
+					else if (iequals(value, "deflate"))
+						inflater.reset(new Inflater(true));
+					else if (!iequals(value, "identity"))
+						throw std::invalid_argument("unsupported Content-Encoding: " + value.to_string());
+				} else if (iequals(name, "connection")) {
+					if (iequals(value, "close"))
+						framing.keep_alive = false;
+					else if (iequals(value, "keep-alive"))
+						framing.keep_alive = true;
+				}
+			}
+
+			// A 304 has no body, whatever its entity headers say.
+			if (not_modified) {
+				inflater.reset();
+				phase = Phase::length_body;
+				framing.remaining = 0;
+				return;
+			}
+
+			++encoding_counters.responses;
+			if (inflater) {
+				++encoding_counters.encoded_responses;
+				Access::encoded(response) = true;
+			}
+			if (framing.chunked) {
+				phase = Phase::chunk_size;
+			} else if (framing.has_length) {
+				phase = Phase::length_body;
+				framing.remaining = framing.length;
+				// the whole body is going to be kept: allocate for it at once
+				if (!sink && !inflater)
+					Access::reserve(response, framing.length);
+			} else {
+				// Body is delimited by EOF; the connection can't be reused.
+				phase = Phase::eof_body;
+				framing.keep_alive = false;
+			}
+		}
+
+		// Append n body bytes at the cursor to the transfer-decoded body, and hand them to
+		// the consumer; encoded content is decompressed on the way.
+		// Ret: n
+		std::size_t emit(std::size_t n)
+		{
+			if (n == 0)
+				return n;
+			char* data = Access::data(response);
+			auto& body_end = Access::body_end(response);
+			if (body_end != cursor)
+				std::memmove(data + body_end, data + cursor, n);
+			encoding_counters.wire_bytes += n;
+			if (inflater) {
+				auto& decoded = Access::decoded(response);
+				bool keep = !sink;
+				inflater->feed(data + body_end, n, [this, &decoded, keep] (char const* out, std::size_t m) {
+					encoding_counters.decoded_bytes += m;
+					if (sink)
+						sink(out, m);
+					if (keep)
+						decoded.append(out, m);
+				});
+			} else {
+				encoding_counters.decoded_bytes += n;
+				if (sink)
+					sink(data + body_end, n);
+			}
+			body_end += n;
+			cursor += n;
+			return n;
+		}
+
+		void finish()
+		{
+			if (inflater && !inflater->complete())
+				throw std::invalid_argument("content decoding error: truncated body");
+			phase_histograms.body.add_duration(Clock::now() - t_first);
+			phase_histograms.bytes.add(received);
+			if (framing.keep_alive && cursor == Access::size(response))
+				pool.checkin(key, std::move(socket));
+			socket.reset();
+			call->succeeded(this);
+		}
+	};
+
+	// Throwing here would leave the caller waiting; the error completes the call instead.
+	void Call::start()
+	{
+		try {
+			begin = Clock::now();
+			if (timing.deadline > std::chrono::milliseconds::zero()) {
+				deadline_timer.expires_from_now(timing.deadline);
+				deadline_timer.async_wait(std::bind(&Call::on_deadline, shared_from_this(), std::placeholders::_1));
+			}
+			if (hedge_after > Clock::duration::zero()) {
+				hedge_timer.expires_from_now(hedge_after);
+				hedge_timer.async_wait(std::bind(&Call::on_hedge, shared_from_this(), std::placeholders::_1));
+			}
+			launch();
+		} catch (...) {
+			if (!finished)
+				complete(std::current_exception());
+		}
+	}
+
+	void Call::launch()
+	{
+		// Only the first exchange reads into the caller's Response; a hedge has its own.
+		auto e (std::make_shared<Exchange>(shared_from_this(), attempts.empty() ? external : nullptr));
+		attempts.push_back(e);
+		e->start();
+	}
+
+	void Call::on_hedge(error_code error)
+	{
+		if (error || finished || winner)
+			return;
+		hedged = true;
+		{
+			std::lock_guard<std::mutex> lock(pool.mtx);
+			++pool.latency.hedges;
+		}
+		try {
+			launch();
+		} catch (...) {
+			// The first exchange may still answer.
+			failed(nullptr, std::current_exception());
+		}
+	}
+
+	void Call::on_deadline(error_code error)
+	{
+		if (error || finished)
+			return;
+		{
+			std::lock_guard<std::mutex> lock(pool.mtx);
+			++pool.latency.timeouts;
+		}
+		complete(std::make_exception_ptr(boost::system::system_error(boost::asio::error::timed_out)));
+	}
+
+	void Call::answered(Exchange* e)
+	{
+		if (winner)
+			return;
+		winner = e;
+		first_byte = Clock::now() - begin;
+		hedge_timer.cancel();
+		for (auto& a : attempts)
+			if (a.get() != e)
+				a->cancel();
+	}
+
+	void Call::failed(Exchange* e, std::exception_ptr error)
+	{
+		if (finished || (winner && winner != e))
+			return;
+		// Unanswered: wait for the other exchange, or for the hedge.
+		if (!winner && ++failures < attempts.size())
+			return;
+		complete(error);
+	}
+
+	void Call::succeeded(Exchange* e)
+	{
+		if (finished)
+			return;
+		if (external && &e->result() != external)
+			std::swap(*external, e->result());
+		{
+			std::lock_guard<std::mutex> lock(pool.mtx);
+			pool.latency.record(first_byte, Clock::now() - begin);
+			if (hedged && e != attempts.front().get())
+				++pool.latency.hedge_wins;
+		}
+		complete(std::exception_ptr());
+	}
+
+	void Call::complete(std::exception_ptr error)
+	{
+		finished = true;
+		deadline_timer.cancel();
+		hedge_timer.cancel();
+		for (auto& a : attempts)
+			a->cancel();
+		// Exchanges refer back to the call; drop them to break the cycle.
+		attempts.clear();
+		{
+			std::lock_guard<std::mutex> lock(pool.mtx);
+			++pool.latency.calls;
+		}
+		auto d (std::move(done));
+		if (d)
+			d(error);
+	}
+}
+
+http::Client::Client(std::size_t max_idle)
+: pool(new detail::Pool(max_idle))
+{ }
+
+http::Client::~Client() = default;
+
+std::string http::Client::query(std::array<std::string, 3> const& uri)
+{
+	if (pool->in_io_thread())
+		throw std::logic_error("http::Client::query called from the I/O thread");
+	return async_query(uri).get();
+}
+
+void http::Client::query(Uri const& uri, Body_consumer consumer)
+{
+	if (pool->in_io_thread())
+		throw std::logic_error("http::Client::query called from the I/O thread");
+	std::promise<void> promise;
+	async_query(uri, std::move(consumer), [&promise] (std::exception_ptr e) {
+		if (e)
+			promise.set_exception(e);
+		else
+			promise.set_value();
+	});
+	promise.get_future().get();
+}
+
+void http::Client::query(Uri const& uri, Response& response)
+{
+	if (pool->in_io_thread())
+		throw std::logic_error("http::Client::query called from the I/O thread");
+	std::promise<void> promise;
+	async_query(uri, response, [&promise] (std::exception_ptr e) {
+		if (e)
+			promise.set_exception(e);
+		else
+			promise.set_value();
+	});
+	promise.get_future().get();
+}
+
+bool http::Client::query(Uri const& uri, Validators const& validators, Response& response)
+{
+	if (pool->in_io_thread())
+		throw std::logic_error("http::Client::query called from the I/O thread");
+	std::promise<void> promise;
+	async_query(uri, validators, response, [&promise] (std::exception_ptr e) {
+		if (e)
+			promise.set_exception(e);
+		else
+			promise.set_value();
+	});
+	promise.get_future().get();
+	return response.status() != 304;
+}
+
+bool http::Client::query(Uri const& uri, Validators const& validators, Response& response, Body_consumer consumer)
+{
+	if (pool->in_io_thread())
+		throw std::logic_error("http::Client::query called from the I/O thread");
+	std::promise<void> promise;
+	async_query(uri, validators, response, std::move(consumer), [&promise] (std::exception_ptr e) {
+		if (e)
+			promise.set_exception(e);
+		else
+			promise.set_value();
+	});
+	promise.get_future().get();
+	return response.status() != 304;
+}
+
+void http::Client::async_query(Uri const& uri, Handler handler)
+{
+	auto response (std::make_shared<Response>());
+	async_query(uri, *response, [response, handler] (std::exception_ptr e) {
+		if (e)
+			handler(e, std::string());
+		else
+			handler(e, response->body().to_string());
+	});
+}
+
+void http::Client::async_query(Uri const& uri, Body_consumer consumer, Completion done)
+{
+	pool->start();
+	auto call (std::make_shared<Call>(*pool, uri, Validators(), std::move(consumer), nullptr, std::move(done)));
+	pool->io_service.post([call] { call->start(); });
+}
+
+void http::Client::async_query(Uri const& uri, Response& response, Completion done)
+{
+	pool->start();
+	auto call (std::make_shared<Call>(*pool, uri, Validators(), Body_consumer(), &response, std::move(done)));
+	pool->io_service.post([call] { call->start(); });
+}
+
+void http::Client::async_query(Uri const& uri, Validators const& validators, Response& response, Completion done)
+{
+	pool->start();
+	auto call (std::make_shared<Call>(*pool, uri, validators, Body_consumer(), &response, std::move(done)));
+	pool->io_service.post([call] { call->start(); });
+}
+
+void http::Client::async_query(Uri const& uri, Validators const& validators, Response& response,
+			       Body_consumer consumer, Completion done)
+{
+	pool->start();
+	auto call (std::make_shared<Call>(*pool, uri, validators, std::move(consumer), &response, std::move(done)));
+	pool->io_service.post([call] { call->start(); });
+}
+
+std::future<std::string> http::Client::async_query(Uri const& uri)
+{
+	auto promise (std::make_shared<std::promise<std::string>>());
+	auto future (promise->get_future());
+	async_query(uri, [promise] (std::exception_ptr e, std::string body) {
+		if (e)
+			promise->set_exception(e);
+		else
+			promise->set_value(std::move(body));
+	});
+	return future;
+}
+
+void http::Client::clear()
+{
+	std::lock_guard<std::mutex> lock(pool->mtx);
+	pool->idle.clear();
+}
+
+void http::Client::set_timing(Timing const& t)
+{
+	std::lock_guard<std::mutex> lock(pool->mtx);
+	pool->timing = t;
+}
+
+http::Timing http::Client::timing() const
+{
+	std::lock_guard<std::mutex> lock(pool->mtx);
+	return pool->timing;
+}
+
+http::Latency_stats http::Client::latency_stats() const
+{
+	using std::chrono::duration_cast;
+	using std::chrono::microseconds;
+	std::lock_guard<std::mutex> lock(pool->mtx);
+	auto const& log = pool->latency;
+	Latency_stats s;
+	s.calls = log.calls;
+	s.timeouts = log.timeouts;
+	s.hedges = log.hedges;
+	s.hedge_wins = log.hedge_wins;
+	s.samples = log.samples();
+	s.ttfb_p50 = duration_cast<microseconds>(log.ttfb_percentile(50));
+	s.ttfb_p90 = duration_cast<microseconds>(log.ttfb_percentile(90));
+	s.ttfb_p99 = duration_cast<microseconds>(log.ttfb_percentile(99));
+	s.total_p50 = duration_cast<microseconds>(log.total_percentile(50));
+	s.total_p99 = duration_cast<microseconds>(log.total_percentile(99));
+	s.hedge_after = microseconds::zero();
+	if (pool->timing.hedge_percentile > 0 && log.samples() >= pool->timing.hedge_min_samples)
+		s.hedge_after = duration_cast<microseconds>(log.ttfb_percentile(pool->timing.hedge_percentile));
+	return s;
+}
+
+http::Client& http::client()
+{
+	static Client c;
+	return c;
+}
+
+std::string http::query(std::array<std::string, 3> uri) {
+	return client().query(uri);
+}
+
+void http::set_dns_ttl(std::chrono::milliseconds ttl)
+{
+	dns_cache().set_ttl(ttl);
+}
+
+http::Dns_stats http::dns_stats()
+{
+	return dns_cache().counters();
+}
+
+void http::set_timing(Timing const& t)
+{
+	client().set_timing(t);
+}
+
+http::Latency_stats http::latency_stats()
+{
+	return client().latency_stats();
+}
+
+http::Encoding_stats http::encoding_stats()
+{
+	Encoding_stats s;
+	s.responses = encoding_counters.responses;
+	s.encoded_responses = encoding_counters.encoded_responses;
+	s.wire_bytes = encoding_counters.wire_bytes;
+	s.decoded_bytes = encoding_counters.decoded_bytes;
+	return s;
+}
+
+void http::query(Uri const& uri, Body_consumer consumer)
+{
+	client().query(uri, std::move(consumer));
+}
+
+void http::query(Uri const& uri, Response& response)
+{
+	client().query(uri, response);
+}
+
+bool http::query(Uri const& uri, Validators const& validators, Response& response)
+{
+	return client().query(uri, validators, response);
+}
+
+bool http::query(Uri const& uri, Validators const& validators, Response& response, Body_consumer consumer)
+{
+	return client().query(uri, validators, response, std::move(consumer));
+}
+
+http::Phase_stats http::phase_stats()
+{
+	Phase_stats s;
+	s.resolve = phase_histograms.resolve.snapshot();
+	s.connect = phase_histograms.connect.snapshot();
+	s.ttfb = phase_histograms.ttfb.snapshot();
+	s.body = phase_histograms.body.snapshot();
+	s.bytes = phase_histograms.bytes.snapshot();
+	return s;
+}
+
+std::ostream& http::operator<< (std::ostream& os, Phase_stats const& stats)
+{
+	auto line = [&os] (char const* name, Histogram const& h) {
+		os << name << " count=" << h.count << " mean=" << (h.count ? h.sum / h.count : 0)
+		   << " p50=" << h.percentile(50) << " p90=" << h.percentile(90)
+		   << " p99=" << h.percentile(99) << " max=" << h.max << '\n';
+	};
+	line("resolve", stats.resolve);
+	line("connect", stats.connect);
+	line("ttfb", stats.ttfb);
+	line("body", stats.body);
+	line("bytes", stats.bytes);
+	return os;
+}
+
+void http::async_query(Uri const& uri, Handler handler)
+{
+	client().async_query(uri, std::move(handler));
+}
+
+void http::async_query(Uri const& uri, Body_consumer consumer, Completion done)
+{
+	client().async_query(uri, std::move(consumer), std::move(done));
+}
+
+void http::async_query(Uri const& uri, Response& response, Completion done)
+{
+	client().async_query(uri, response, std::move(done));
+}
+
+std::future<std::string> http::async_query(Uri const& uri)
+{
+	return client().async_query(uri);
+}
+
+void http::async_query(Uri const& uri, Validators const& validators, Response& response, Completion done)
+{
+	client().async_query(uri, validators, response, std::move(done));
+}
 
-	// Get a list of endpoints corresponding to the server name.
-	tcp::resolver resolver(io_service);
-	tcp::resolver::query query(uri[1], uri[0]);
-	tcp::resolver::iterator endpoint_iterator = resolver.resolve(query);
-
-	// Try each endpoint until we successfully establish a connection.
-	tcp::socket socket(io_service);
-	boost::asio::connect(socket, endpoint_iterator);
-
-	// Form the request. We specify the "Connection: close" header so that the
-	// server will close the socket after transmitting the response. This will
-	// allow us to treat all data up until the EOF as the content.
-	boost::asio::streambuf request;
-	std::ostream request_stream(&request);
-	request_stream << "GET " << uri[2] << " HTTP/1.0\r\n";
-	request_stream << "Host: " << uri[1] << "\r\n";
-	request_stream << "Accept: */*\r\n";
-	request_stream << "Connection: close\r\n\r\n";
-
-	// Send the request.
-	boost::asio::write(socket, request);
-
-	// Read the response status line. The response streambuf will automatically
-	// grow to accommodate the entire line. The growth may be limited by passing
-	// a maximum size to the streambuf constructor.
-	boost::asio::streambuf response;
-	boost::asio::read_until(socket, response, "\r\n");
-
-	// Check that response is OK.
-	std::istream response_stream(&response);
-	std::string http_version;
-	response_stream >> http_version;
-	unsigned int status_code;
-	response_stream >> status_code;
-	std::string status_message;
-	std::getline(response_stream, status_message);
-	if (!response_stream || http_version.substr(0, 5) != "HTTP/")
-		throw std::logic_error("ill-formed HTTP response");
-	if (status_code != 200)
-		throw std::invalid_argument(
-			([status_code] {
-				std::stringstream s;
-				s << "HTTP status code: "; s << status_code; s << "\n"; 
-				std::string ss(s.str());
-				return ss;
-			})());
-
-	// Read the response headers, which are terminated by a blank line.
-	boost::asio::read_until(socket, response, "\r\n\r\n");
-
-	// Process the response headers.
-	std::string header;
-	std::string headers;
-	while (std::getline(response_stream, header) && header != "\r") {
-		headers += header;
-		headers += "\n";
-	}
-
-	std::stringstream data;
-	// Write whatever content we already have to output.
-	if (response.size() > 0)
-		data << &response;
-
-	// Read until EOF, writing data to output as we go.
-	boost::system::error_code error;
-	while (boost::asio::read(socket, response, boost::asio::transfer_at_least(1), error))
-		data << &response;
-	if (error != boost::asio::error::eof)
-		throw boost::system::system_error(error);
-
-	return data.str();
+void http::async_query(Uri const& uri, Validators const& validators, Response& response,
+		       Body_consumer consumer, Completion done)
+{
+	client().async_query(uri, validators, response, std::move(consumer), std::move(done));
 }
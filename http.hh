@@ -11,15 +11,472 @@
 #ifndef HTTP_HH
 #define HTTP_HH
 
+#include <algorithm>
+#include <cctype>
+#include <cstddef>
 #include <array>
+#include <chrono>
+#include <exception>
+#include <functional>
+#include <future>
+#include <iosfwd>
+#include <memory>
 #include <string>
+#include <boost/utility/string_ref.hpp>
 
 namespace http {
 
+// Request target: protocol uri[0], domain uri[1], query_string uri[2]
+typedef std::array<std::string, 3> Uri;
+
+// Completion handler for asynchronous queries.
+// Exactly one of the arguments is meaningful: on failure, the exception_ptr is non-null
+// and holds what the blocking query() would have thrown; otherwise it holds the body.
+// Handlers run on the client's I/O thread; they must not throw, and must not call
+// the blocking query() of the same client.
+typedef std::function<void(std::exception_ptr, std::string)> Handler;
+
+// Consumer of a streamed response body.
+// Called with each piece of the body, in order, as it arrives from the socket;
+// chunked transfer encoding and gzip/deflate content encoding have already been removed.
+// The data is only valid for the duration of the call. Consumers run on the client's I/O
+// thread; an exception thrown by a consumer aborts the request and is passed to its Completion.
+typedef std::function<void(char const*, std::size_t)> Body_consumer;
+
+// Completion handler for streamed queries; the exception_ptr is null on success.
+typedef std::function<void(std::exception_ptr)> Completion;
+
+namespace detail {
+	// Connection pool and I/O thread backing a Client; defined in http.cc
+	struct Pool;
+	// Writer side of Response; defined in http.cc
+	struct Response_access;
+}
+
+// Validators.
+// Cache validators of a previously received response, sent back on a conditional request
+// as If-None-Match and If-Modified-Since. Empty members aren't sent.
+struct Validators {
+	// value of the ETag response header
+	std::string etag;
+	// value of the Last-Modified response header
+	std::string last_modified;
+};
+
+// Response.
+// A HTTP response held in one contiguous buffer which socket reads write into directly.
+// The status line, header block and body are views into that buffer; chunked transfer
+// encoding is removed in place. The buffer is kept across queries, so a Response which
+// is reused doesn't allocate once it has grown to the working size.
+// A gzip or deflate encoded body is decompressed into a second reusable buffer, which
+// body() then refers to.
+//
+// Views are invalidated by the next query into the same Response.
+class Response
+{
+public:
+	Response() = default;
+	Response(Response&&) = default;
+	Response& operator= (Response&&) = default;
+
+	// HTTP status code
+	unsigned status() const
+	{ return code; }
+
+	// status line, without line terminator
+	boost::string_ref status_line() const
+	{ return boost::string_ref(buf.get(), status_end); }
+
+	// header lines, CRLF-delimited, without the status line and the terminating blank line
+	boost::string_ref headers() const
+	{ return headers_end ? boost::string_ref(buf.get() + status_end + 2, headers_end - status_end - 4)
+			     : boost::string_ref(); }
+
+	// boost::string_ref header(boost::string_ref name) const.
+	// Fetch the value of the first header named `name`, compared case-insensitively.
+	//
+	// Arg: boost::string_ref name - header name, without colon
+	// Ret: header value without surrounding whitespace, or an empty view if absent
+	boost::string_ref header(boost::string_ref name) const
+	{
+		auto h (headers());
+		while (!h.empty()) {
+			auto eol = h.find("\r\n");
+			auto line = h.substr(0, eol);
+			h = (eol == boost::string_ref::npos) ? boost::string_ref() : h.substr(eol + 2);
+			if (line.size() <= name.size() || line[name.size()] != ':')
+				continue;
+			bool match = true;
+			for (std::size_t i = 0; match && i < name.size(); ++i)
+				match = (std::tolower(static_cast<unsigned char>(line[i]))
+					 == std::tolower(static_cast<unsigned char>(name[i])));
+			if (!match)
+				continue;
+			auto value = line.substr(name.size() + 1);
+			while (!value.empty() && (value.front() == ' ' || value.front() == '\t'))
+				value.remove_prefix(1);
+			while (!value.empty() && (value.back() == ' ' || value.back() == '\t'))
+				value.remove_suffix(1);
+			return value;
+		}
+		return boost::string_ref();
+	}
+
+	// body, with transfer and content encodings removed
+	boost::string_ref body() const
+	{ return encoded ? boost::string_ref(decoded) : wire_body(); }
+
+	// body as received, with only transfer encoding removed
+	boost::string_ref wire_body() const
+	{ return boost::string_ref(buf.get() + headers_end, body_end - headers_end); }
+
+	// Forget the contents, keeping the buffers.
+	void clear()
+	{ size = status_end = headers_end = body_end = 0; code = 0; encoded = false; decoded.clear(); }
+
+	// allocated buffer size
+	std::size_t capacity() const
+	{ return cap; }
+
+private:
+	friend struct detail::Response_access;
+	std::unique_ptr<char[]> buf;
+	std::size_t cap = 0;
+	// bytes received
+	std::size_t size = 0;
+	// offset of the CRLF ending the status line
+	std::size_t status_end = 0;
+	// offset of the body, past the blank line ending the headers
+	std::size_t headers_end = 0;
+	// offset past the transfer-decoded body
+	std::size_t body_end = 0;
+	unsigned code = 0;
+	// whether the body had a content encoding, and its decompressed form
+	bool encoded = false;
+	std::string decoded;
+};
+
+// Timing.
+// Time limits applied to each call of a Client.
+struct Timing {
+	// time allowed for a whole call, from its start to the end of the body; zero means no limit.
+	// A call which runs out of time fails with boost::system::system_error (timed_out).
+	std::chrono::milliseconds deadline = std::chrono::milliseconds::zero();
+	// Hedging: if no response byte has arrived after this percentile (0-100] of the recent
+	// times to first byte, a duplicate request is sent on another connection, and whichever
+	// of the two is answered first is kept. Zero disables hedging.
+	double hedge_percentile = 0;
+	// number of recent calls needed before the hedge threshold is trusted
+	std::size_t hedge_min_samples = 20;
+};
+
+// Latency_stats.
+// Call counters of a Client, and latency percentiles over its most recent successful calls.
+struct Latency_stats {
+	// completed calls, successful or not
+	unsigned long long calls;
+	// calls which ran out of time
+	unsigned long long timeouts;
+	// duplicate requests sent
+	unsigned long long hedges;
+	// calls answered by the duplicate rather than the original request
+	unsigned long long hedge_wins;
+	// number of calls the percentiles are over
+	std::size_t samples;
+	// time to first response byte
+	std::chrono::microseconds ttfb_p50, ttfb_p90, ttfb_p99;
+	// time to the end of the body
+	std::chrono::microseconds total_p50, total_p99;
+	// current hedge threshold; zero while hedging is disabled or not warmed up
+	std::chrono::microseconds hedge_after;
+};
+
+// Client.
+// A HTTP/1.1 keep-alive client owning a pool of idle connections per host.
+// Connections are checked out for the duration of a request and returned afterwards,
+// unless the server asked for the connection to be closed.
+// A pooled connection which the server has since closed is transparently replaced by
+// a fresh one.
+//
+// All requests run on a single io_service driven by one I/O thread, started on first use;
+// any number of asynchronous requests may be in flight at once, each on its own connection.
+// The blocking query() is a wait on the asynchronous one.
+// Calls may be given a deadline, and hedged with a duplicate request when slow to be
+// answered; see Timing.
+//
+// Thread-safe: concurrent queries check out distinct connections.
+class Client
+{
+public:
+	// Arg: size_t max_idle - maximum number of idle connections kept per host
+	explicit Client(std::size_t max_idle = 4);
+	~Client();
+	Client(Client const&) = delete;
+	Client& operator= (Client const&) = delete;
+
+	// std::string query(std::array<std::string, 3> const& uri).
+	// Make a HTTP GET request, given protocol uri[0], domain uri[1], query_string uri[2]
+	//
+	// Arg: std::array<std::string, 3> const& uri - request target
+	// Ret: response body
+	// Throw: std::invalid_argument if non-200 status returned by remote side
+	// Throw: std::logic_error if the response is ill-formed
+	// Throw: boost::system::system_error on I/O failure
+	std::string query(std::array<std::string, 3> const& uri);
+
+	// void query(Uri const& uri, Body_consumer consumer).
+	// Make a HTTP GET request, streaming the body into `consumer` as it arrives.
+	// Blocks until the body is complete; throws as query(uri) does, or whatever
+	// `consumer` threw.
+	//
+	// Arg: Uri const& uri - request target
+	// Arg: Body_consumer consumer - receiver of body pieces
+	void query(Uri const& uri, Body_consumer consumer);
+
+	// void query(Uri const& uri, Response& response).
+	// Make a HTTP GET request, reading the response into `response`, whose buffer is reused.
+	// Blocks until the body is complete; throws as query(uri) does.
+	//
+	// Arg: Uri const& uri - request target
+	// Arg: Response& response - output response
+	void query(Uri const& uri, Response& response);
+
+	// bool query(Uri const& uri, Validators const& validators, Response& response).
+	// Make a conditional HTTP GET request into `response`. A 304 Not Modified reply is
+	// not an error: `response` then holds its status and headers, with an empty body.
+	// Blocks until the body is complete; throws as query(uri) does on any other status.
+	//
+	// Arg: Uri const& uri - request target
+	// Arg: Validators const& validators - validators of the cached copy
+	// Arg: Response& response - output response
+	// Ret: false if the cached copy is still valid (status 304), true otherwise
+	bool query(Uri const& uri, Validators const& validators, Response& response);
+
+	// bool query(Uri const& uri, Validators const& validators, Response& response, Body_consumer consumer).
+	// Make a conditional HTTP GET request, streaming a 200 body into `consumer` as it arrives;
+	// `response` gets the status and headers only. A 304 reply has no body, so `consumer`
+	// isn't called. Blocks and throws as the streamed query(uri, consumer) does.
+	//
+	// Arg: Uri const& uri - request target
+	// Arg: Validators const& validators - validators of the cached copy
+	// Arg: Response& response - output status and headers
+	// Arg: Body_consumer consumer - receiver of body pieces
+	// Ret: false if the cached copy is still valid (status 304), true otherwise
+	bool query(Uri const& uri, Validators const& validators, Response& response, Body_consumer consumer);
+
+	// void async_query(Uri const& uri, Handler handler).
+	// Start a HTTP GET request and return immediately; `handler` is invoked on completion.
+	//
+	// Arg: Uri const& uri - request target
+	// Arg: Handler handler - completion handler
+	void async_query(Uri const& uri, Handler handler);
+
+	// std::future<std::string> async_query(Uri const& uri).
+	// Start a HTTP GET request and return a future for its body.
+	// The future rethrows whatever query() would have thrown.
+	//
+	// Arg: Uri const& uri - request target
+	// Ret: future response body
+	std::future<std::string> async_query(Uri const& uri);
+
+	// void async_query(Uri const& uri, Body_consumer consumer, Completion done).
+	// Start a HTTP GET request, streaming the body into `consumer`; `done` is invoked
+	// once the body is complete or the request failed.
+	//
+	// Arg: Uri const& uri - request target
+	// Arg: Body_consumer consumer - receiver of body pieces
+	// Arg: Completion done - completion handler
+	void async_query(Uri const& uri, Body_consumer consumer, Completion done);
+
+	// void async_query(Uri const& uri, Response& response, Completion done).
+	// Start a HTTP GET request, reading the response into `response`; `done` is invoked
+	// once the body is complete or the request failed. `response` must outlive the request.
+	//
+	// Arg: Uri const& uri - request target
+	// Arg: Response& response - output response
+	// Arg: Completion done - completion handler
+	void async_query(Uri const& uri, Response& response, Completion done);
+
+	// void async_query(Uri const& uri, Validators const& validators, Response& response, Completion done).
+	// Start a conditional HTTP GET request into `response`; a 304 Not Modified reply completes
+	// successfully, with response.status() == 304.
+	//
+	// Arg: Uri const& uri - request target
+	// Arg: Validators const& validators - validators of the cached copy
+	// Arg: Response& response - output response
+	// Arg: Completion done - completion handler
+	void async_query(Uri const& uri, Validators const& validators, Response& response, Completion done);
+
+	// void async_query(Uri const& uri, Validators const& validators, Response& response,
+	//		    Body_consumer consumer, Completion done).
+	// Start a conditional HTTP GET request, streaming a 200 body into `consumer`; `response`
+	// gets the status and headers, and must outlive the request.
+	//
+	// Arg: Uri const& uri - request target
+	// Arg: Validators const& validators - validators of the cached copy
+	// Arg: Response& response - output status and headers
+	// Arg: Body_consumer consumer - receiver of body pieces
+	// Arg: Completion done - completion handler
+	void async_query(Uri const& uri, Validators const& validators, Response& response,
+			 Body_consumer consumer, Completion done);
+
+	// Drop all idle connections.
+	void clear();
+
+	// void set_timing(Timing const& t).
+	// Set the deadline and hedging policy of calls started from now on.
+	//
+	// Arg: Timing const& t - time limits
+	void set_timing(Timing const& t);
+
+	// Timing timing() const.
+	// Ret: the current time limits; by default, none
+	Timing timing() const;
+
+	// Latency_stats latency_stats() const.
+	// Snapshot the call counters and latency percentiles.
+	Latency_stats latency_stats() const;
+private:
+	std::unique_ptr<detail::Pool> pool;
+};
+
+// Client& client().
+// The process-wide client used by query().
+Client& client();
+
 // Make a HTTP GET request, given protocol uri[0], domain uri[1], query_string uri[2]
 // Throws std::invalid_argument if non-200 status returned by remote side
+// Equivalent to client().query(uri).
 std::string query(std::array<std::string, 3> uri);
 
+// Make a streamed HTTP GET request on client(); see Client::query.
+void query(Uri const& uri, Body_consumer consumer);
+
+// Make a HTTP GET request on client() into a reusable Response; see Client::query.
+void query(Uri const& uri, Response& response);
+
+// Make a conditional HTTP GET request on client(); see Client::query.
+bool query(Uri const& uri, Validators const& validators, Response& response);
+
+// Make a conditional, streamed HTTP GET request on client(); see Client::query.
+bool query(Uri const& uri, Validators const& validators, Response& response, Body_consumer consumer);
+
+// Dns_stats.
+// Counters of the process-wide resolver cache shared by all clients.
+struct Dns_stats {
+	// lookups served from the cache, whether fresh or expired
+	unsigned long long hits;
+	// lookups which had to wait for the resolver
+	unsigned long long misses;
+	// background refreshes of expired entries
+	unsigned long long refreshes;
+	// failed background refreshes; the cached endpoints were kept
+	unsigned long long refresh_failures;
+};
+
+// void set_dns_ttl(std::chrono::milliseconds).
+// Set the time a resolved endpoint list is considered fresh; default is 60 seconds.
+// Expired entries keep being served while a background refresh runs.
+// A TTL of zero disables the cache.
+//
+// Arg: std::chrono::milliseconds ttl - time to live of cached entries
+void set_dns_ttl(std::chrono::milliseconds ttl);
+
+// Dns_stats dns_stats().
+// Snapshot the resolver cache counters.
+Dns_stats dns_stats();
+
+// Set the time limits of client(); see Client::set_timing.
+void set_timing(Timing const& t);
+
+// Snapshot the latency statistics of client(); see Client::latency_stats.
+Latency_stats latency_stats();
+
+// Encoding_stats.
+// Process-wide counters of response body bytes before and after content decoding.
+// The client advertises gzip and deflate; identity-coded bodies count equally on both sides.
+struct Encoding_stats {
+	// responses whose body was read
+	unsigned long long responses;
+	// of which gzip or deflate encoded
+	unsigned long long encoded_responses;
+	// body bytes as transferred (after chunked decoding)
+	unsigned long long wire_bytes;
+	// body bytes after content decoding
+	unsigned long long decoded_bytes;
+};
+
+// Encoding_stats encoding_stats().
+// Snapshot the content encoding counters.
+Encoding_stats encoding_stats();
+
+// Histogram.
+// Snapshot of a histogram with power-of-two buckets: bucket 0 counts zeros, and bucket
+// i > 0 counts values in [2^(i-1), 2^i).
+struct Histogram {
+	static std::size_t const buckets = 48;
+	std::array<unsigned long long, buckets> counts;
+	// number, sum and maximum of the values recorded
+	unsigned long long count;
+	unsigned long long sum;
+	unsigned long long max;
+
+	// unsigned long long percentile(double p) const.
+	// Ret: upper bound of the bucket holding the p-th percentile (0 < p <= 100), capped
+	//      by max; 0 if empty
+	unsigned long long percentile(double p) const
+	{
+		auto rank = static_cast<unsigned long long>(p / 100 * count + 0.5);
+		unsigned long long seen = 0;
+		for (std::size_t i = 0; i < buckets; ++i) {
+			seen += counts[i];
+			if (seen >= rank && seen > 0)
+				return i ? std::min(max, (1ULL << i) - 1) : 0;
+		}
+		return max;
+	}
+};
+
+// Phase_stats.
+// Process-wide breakdown of where the time of HTTP exchanges goes, each phase being
+// recorded when it completes. Durations are in microseconds.
+struct Phase_stats {
+	// name lookups which went to the resolver, rather than the cache
+	Histogram resolve;
+	// TCP connection setup, for exchanges which didn't reuse a pooled connection
+	Histogram connect;
+	// from sending the request to the first response byte
+	Histogram ttfb;
+	// from the first response byte to the end of the body
+	Histogram body;
+	// bytes received per exchange, headers included
+	Histogram bytes;
+};
+
+// Phase_stats phase_stats().
+// Snapshot the phase histograms. Recording is lock-free, and cheap enough to be always on.
+Phase_stats phase_stats();
+
+// std::ostream& operator<< (std::ostream&, Phase_stats const&).
+// Dump the phase histograms, one line per phase:
+//	PHASE count=N mean=M p50=A p90=B p99=C max=D
+// with durations in microseconds and sizes in bytes; percentiles are bucket upper bounds.
+std::ostream& operator<< (std::ostream& os, Phase_stats const& stats);
+
+// Start a HTTP GET request on client(); see Client::async_query.
+void async_query(Uri const& uri, Handler handler);
+// Start a HTTP GET request on client() and return a future for its body.
+std::future<std::string> async_query(Uri const& uri);
+// Start a streamed HTTP GET request on client(); see Client::async_query.
+void async_query(Uri const& uri, Body_consumer consumer, Completion done);
+// Start a HTTP GET request on client() into a Response; see Client::async_query.
+void async_query(Uri const& uri, Response& response, Completion done);
+// Start a conditional HTTP GET request on client(); see Client::async_query.
+void async_query(Uri const& uri, Validators const& validators, Response& response, Completion done);
+// Start a conditional, streamed HTTP GET request on client(); see Client::async_query.
+void async_query(Uri const& uri, Validators const& validators, Response& response,
+		 Body_consumer consumer, Completion done);
+
 }
 
 #endif
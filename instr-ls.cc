@@ -11,7 +11,12 @@
 // parts from http://stackoverflow.com/a/16976703/982617
 
 #include <array>
+#include <cctype>
+#include <cstddef>
+#include <exception>
+#include <future>
 #include <memory>
+#include <mutex>
 #include <string>
 #include <stdexcept>
 #include <vector>
@@ -20,23 +25,58 @@ extern "C" {
 #include <json-c/json.h>
 }
 
+#include <util.hh>
 #include <http.hh>
+#include <symbols.hh>
 #include <instr-ls.hh>
 
 namespace {
 
-	std::vector<std::string> parse_json(const std::string& data) {
+	struct JsonC_deleter { // json_object refcount decrementer
+		void operator() (json_object* o) const
+		{ json_object_put(o); }
+	};
+
+	// Incremental json-c parser, fed body pieces as they arrive from http.
+	class Json_stream {
+	public:
+		Json_stream()
+		: tok(json_tokener_new(), json_tokener_free)
+		{ }
+
+		void operator() (char const* data, std::size_t n) {
+			if (root) {
+				// only trailing whitespace may follow the document
+				for (std::size_t i = 0; i < n; ++i)
+					if (!std::isspace(static_cast<unsigned char>(data[i])))
+						throw std::invalid_argument("JSON error: trailing data");
+				return;
+			}
+			auto obj = json_tokener_parse_ex(tok.get(), data, util::checked_cast<int>(n));
+			if (obj) {
+				root.reset(obj, JsonC_deleter());
+				return;
+			}
+			auto err = json_tokener_get_error(tok.get());
+			if (err != json_tokener_continue)
+				throw std::invalid_argument(std::string("JSON error: ") + json_tokener_error_desc(err));
+		}
+
+		json_object* get() const {
+			if (!root)
+				throw std::invalid_argument("JSON error: incomplete document");
+			return root.get();
+		}
+	private:
+		std::unique_ptr<json_tokener, void(*)(json_tokener*)> tok;
+		std::shared_ptr<json_object> root;
+	};
+
+	std::vector<std::string> parse_json(json_object* j_rootobj) {
 		typedef json_object* J_obj; // non-refcounted json_object
 		std::vector<std::string> result;
 
-		struct JsonC_deleter { // json_object refcount decrementer
-			void operator() (json_object* o) const
-			{ json_object_put(o); }
-		};
-
 		// json bits adapted from json-c array answer on SO and json-c docs
-		std::shared_ptr<json_object> j_rootobj(json_tokener_parse(data.c_str()), JsonC_deleter());
-
 		auto json_try_get = [] (J_obj root, const char* name) -> J_obj {
 			J_obj val;
 			if (!json_object_object_get_ex(root, name, &val))
@@ -44,15 +84,54 @@ namespace {
 			return val;
 		};
 
-		auto j_instruments = json_try_get(j_rootobj.get(), "instruments");
+		auto j_instruments = json_try_get(j_rootobj, "instruments");
 		auto ninstruments = json_object_array_length(j_instruments);
 		for (auto i = 0; i < ninstruments; ++i) {
 			auto j_instr = json_object_array_get_idx(j_instruments, i);
 			result.push_back(json_object_get_string(json_try_get(j_instr, "instrument")));
+			// fill the symbol table while the listing is at hand
+			symbols::intern_instrument(result.back());
 		}
 		return result;
 	}
 
+	// Last instruments list received, with the validators to revalidate it by.
+	// If the server supplied no validator, every request is unconditional.
+	class Listing_cache {
+	public:
+		http::Validators validators() const {
+			std::lock_guard<std::mutex> lock(mtx);
+			return cached;
+		}
+
+		std::vector<std::string> get() const {
+			std::lock_guard<std::mutex> lock(mtx);
+			return instruments;
+		}
+
+		// Remember a 200 response, whose body `json` has parsed as it arrived.
+		std::vector<std::string> update(http::Response const& response, Json_stream const& json) {
+			auto result (parse_json(json.get()));
+
+			http::Validators v;
+			v.etag = response.header("ETag").to_string();
+			v.last_modified = response.header("Last-Modified").to_string();
+			std::lock_guard<std::mutex> lock(mtx);
+			cached = std::move(v);
+			instruments = result;
+			return result;
+		}
+	private:
+		mutable std::mutex mtx;
+		http::Validators cached;
+		std::vector<std::string> instruments;
+	};
+
+	Listing_cache& listing_cache() {
+		static Listing_cache c;
+		return c;
+	}
+
 	std::array<std::string, 3> make_query_url() {
 		std::string prot("http");
 		std::string domain("api-sandbox.oanda.com");
@@ -61,7 +140,35 @@ namespace {
 	}
 }
 
+// A 304 leaves the parser unused; a 200 body is parsed as it arrives.
 std::vector<std::string> instruments::list() {
-	return parse_json(http::query(make_query_url()));
+	http::Response response;
+	auto json (std::make_shared<Json_stream>());
+	auto validators (listing_cache().validators());
+	if (!http::query(make_query_url(), validators, response,
+			 [json] (char const* data, std::size_t n) { (*json)(data, n); }))
+		return listing_cache().get();
+	return listing_cache().update(response, *json);
 }
 
+std::future<std::vector<std::string>> instruments::list_async() {
+	auto promise (std::make_shared<std::promise<std::vector<std::string>>>());
+	auto response (std::make_shared<http::Response>());
+	auto json (std::make_shared<Json_stream>());
+	auto future (promise->get_future());
+	http::async_query(make_query_url(), listing_cache().validators(), *response,
+		[json] (char const* data, std::size_t n) { (*json)(data, n); },
+		[promise, response, json] (std::exception_ptr e) {
+			try {
+				if (e)
+					std::rethrow_exception(e);
+				if (response->status() == 304)
+					promise->set_value(listing_cache().get());
+				else
+					promise->set_value(listing_cache().update(*response, *json));
+			} catch (...) {
+				promise->set_exception(std::current_exception());
+			}
+		});
+	return future;
+}
@@ -10,6 +10,7 @@
 
 #include <vector>
 #include <string>
+#include <future>
 
 namespace instruments {
 
@@ -17,8 +18,15 @@ namespace instruments {
 	// Returns a list of available 	instruments. There is no guarantee that the graph
 	// representation is strongly cyclic, (that is, every vertex is part of a cycle).
 	// Postprocessing with pruner strongly recommended.
+	// The instruments are interned in the symbols table as they are parsed.
+	// The last list received is cached with its ETag and Last-Modified validators; later
+	// calls revalidate it with a conditional request and return it as is if unchanged.
 	std::vector<std::string> list();
 
+	// std::future<std::vector<std::string>> list_async().
+	// Asynchronous counterpart of list(); the request runs on the http::client() I/O thread.
+	std::future<std::vector<std::string>> list_async();
+
 }
 
 #endif
@@ -18,6 +18,7 @@
 #include <algo.hh>
 #include <c-print.hh>
 #include <util.hh>
+#include <symbols.hh>
 #include <g-common.hh>
 
 namespace labeled {
@@ -137,7 +138,8 @@ namespace labeled {
 	}
 
 	// Graph<G>.
-	// A labeled graph, where a graph is coupled with a vector of labels describing the vertices.
+	// A labeled graph, where a graph is coupled with a vector of labels describing the vertices,
+	// and the symbols ids of the same.
 	//
 	// Printing via ostream yields a tuple print of c_print printers, with "vertices" and "edges"
 	// prefixes occurring before the enumeration of the labeled vertices and edges.
@@ -150,13 +152,18 @@ namespace labeled {
 		G graph;
 		// the label vector
 		std::vector<std::string> labels;
+		// symbols::Id of each vertex, parallel to labels
+		std::vector<symbols::Id> ids;
 
 		Graph() = default;
 
 		template <typename G_, typename L_>
 		Graph(G_&& g, L_&& l)
 		: graph(std::forward<G_>(g)), labels(std::forward<L_>(l))
-		{ }
+		{
+			for (auto const& label : labels)
+				ids.push_back(symbols::intern(label));
+		}
 	};
 	template <typename CT, typename TT, typename G>
 	std::basic_ostream<CT,TT>& operator<< (std::basic_ostream<CT,TT>& os, Graph<G> const& lg)
@@ -0,0 +1,266 @@
+//          Copyright Andrey Moshbear 2014-2015.
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file LICENSE_1_0.txt or copy at
+//          http://www.boost.org/LICENSE_1_0.txt)
+//
+// Synthetic currency market generator, for running the pipeline on more currencies than
+// the sandbox has.
+
+// Args: optional, in any order
+//	-n COUNT currencies; default 100
+//	-d DENSITY probability of an instrument between two currencies; default 0.1
+//	   (a random spanning tree keeps the market connected whatever the density)
+//	-s SPREAD median relative bid/ask spread; default 0.0002
+//	-v SIGMA log-normal spread dispersion; default 0.5
+//	-c LENGTH:PROFIT plants an arbitrage cycle through LENGTH currencies; repeatable
+//	-r SEED seeds the generator; default 1
+//	-o DIR writes mock fixtures INSTRUMENTS.json, INSTRUMENTS.valid and RATES.hx to DIR,
+//	       and the planted cycles to DIR/PLANTED
+// Output: each line of stdout contains { Instrument Bid Ask }, space-delimited, as run-graph reads
+//	   planted cycles go to stderr unless -o is given, one per line:
+//		X01;...;X01 LRATE
+//	   as run-graph would print them
+//
+// Quotes derive from a random value per currency, so that apart from the spread the
+// market is free of arbitrage. A planted cycle of PROFIT p has the quotes along it skewed
+// so that its log-rate, as graph::best_path evaluates paths, is lowered by log(1 + p).
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <random>
+#include <set>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+#define ARGCHK(x,a) !strncmp(x, a, sizeof a)
+
+namespace {
+
+	struct Options {
+		std::size_t currencies = 100;
+		double density = 0.1;
+		double spread = 0.0002;
+		double spread_sigma = 0.5;
+		// planted cycles: length, profit
+		std::vector<std::pair<std::size_t, double>> cycles;
+		unsigned seed = 1;
+		std::string dir;
+	} options;
+
+	struct Instrument {
+		std::size_t base;
+		std::size_t quote;
+		double bid;
+		double ask;
+	};
+
+	// Currency names: AAA, AAB, ...; longer once three letters run out.
+	std::vector<std::string> make_names(std::size_t n)
+	{
+		std::size_t width = 3;
+		for (std::size_t cap = 26 * 26 * 26; cap < n; cap *= 26)
+			++width;
+		std::vector<std::string> names;
+		for (std::size_t i = 0; i < n; ++i) {
+			std::string name (width, 'A');
+			for (std::size_t j = width, k = i; j-- > 0; k /= 26)
+				name[j] = static_cast<char>('A' + k % 26);
+			names.push_back(name);
+		}
+		return names;
+	}
+
+	class Market
+	{
+	public:
+		Market(std::mt19937& rng_)
+		: rng(rng_), names(make_names(options.currencies))
+		{
+			std::normal_distribution<double> log_value (0, 1.5);
+			for (std::size_t i = 0; i < names.size(); ++i)
+				value.push_back(std::exp(log_value(rng)));
+			// spanning tree, then random extra pairs
+			for (std::size_t i = 1; i < names.size(); ++i)
+				add(std::uniform_int_distribution<std::size_t>(0, i - 1)(rng), i);
+			std::bernoulli_distribution pick (options.density);
+			for (std::size_t i = 0; i < names.size(); ++i)
+				for (std::size_t j = i + 1; j < names.size(); ++j)
+					if (pick(rng))
+						add(i, j);
+		}
+
+		// Plant a cycle through `length` distinct currencies, lowering its log-rate by log(1 + profit).
+		// Ret: the cycle, open
+		std::vector<std::size_t> plant(std::size_t length, double profit)
+		{
+			if (length < 3 || length > names.size())
+				throw std::invalid_argument("cycle length must be between 3 and the currency count");
+			std::vector<std::size_t> order (names.size());
+			for (std::size_t i = 0; i < order.size(); ++i)
+				order[i] = i;
+			std::shuffle(order.begin(), order.end(), rng);
+			order.resize(length);
+			// Spread the skew evenly over the edges of the cycle.
+			double k = std::pow(1 + profit, 1.0 / static_cast<double>(length));
+			for (std::size_t i = 0; i < length; ++i) {
+				auto u = order[i];
+				auto v = order[(i + 1) % length];
+				auto& instr = instruments[add(u, v)];
+				// u->v weighs -log(ask) if the instrument is u_v, log(bid) if it is v_u
+				double f = (instr.base == u) ? k : 1 / k;
+				instr.bid *= f;
+				instr.ask *= f;
+			}
+			return order;
+		}
+
+		// Log-rate of a closed cycle, as g_rategraph::evaluate_path computes it
+		double lrate(std::vector<std::size_t> const& cycle) const
+		{
+			double acc = 0;
+			for (std::size_t i = 0; i < cycle.size(); ++i) {
+				auto u = cycle[i];
+				auto v = cycle[(i + 1) % cycle.size()];
+				auto const& instr = instruments[index.at(key(u, v))];
+				acc += (instr.base == u) ? -std::log(instr.ask) : std::log(instr.bid);
+			}
+			return acc;
+		}
+
+		std::string name(Instrument const& instr) const
+		{ return names[instr.base] + '_' + names[instr.quote]; }
+
+		std::mt19937& rng;
+		std::vector<std::string> const names;
+		std::vector<Instrument> instruments;
+
+	private:
+		std::vector<double> value;
+		std::map<std::pair<std::size_t, std::size_t>, std::size_t> index;
+
+		static std::pair<std::size_t, std::size_t> key(std::size_t u, std::size_t v)
+		{ return std::make_pair(std::min(u, v), std::max(u, v)); }
+
+		// Add an instrument between u and v, in a random direction, unless there is one.
+		// Ret: its index
+		std::size_t add(std::size_t u, std::size_t v)
+		{
+			auto it = index.find(key(u, v));
+			if (it != index.end())
+				return it->second;
+			if (std::bernoulli_distribution(0.5)(rng))
+				std::swap(u, v);
+			std::lognormal_distribution<double> spread (std::log(options.spread), options.spread_sigma);
+			double mid = value[u] / value[v];
+			double s = spread(rng);
+			instruments.push_back({ u, v, mid * (1 - s / 2), mid * (1 + s / 2) });
+			index[key(u, v)] = instruments.size() - 1;
+			return instruments.size() - 1;
+		}
+	};
+
+	std::string format(double d)
+	{
+		char buf[32];
+		std::snprintf(buf, sizeof buf, "%.10g", d);
+		return buf;
+	}
+
+	void write_fixtures(Market const& m, std::string const& dir)
+	{
+		std::vector<std::string> names;
+		for (auto const& instr : m.instruments)
+			names.push_back(m.name(instr));
+
+		std::ofstream json ((dir + "/INSTRUMENTS.json").c_str());
+		json << "{\n \"instruments\": [";
+		for (std::size_t i = 0; i < names.size(); ++i) {
+			auto const& instr = m.instruments[i];
+			json << (i ? ",\n" : "\n")
+			     << "  {\n"
+			     << "   \"instrument\": \"" << names[i] << "\",\n"
+			     << "   \"displayName\": \"" << m.names[instr.base] << '/' << m.names[instr.quote] << "\",\n"
+			     << "   \"pip\": \"0.0001\",\n"
+			     << "   \"maxTradeUnits\": 10000000\n"
+			     << "  }";
+		}
+		json << "\n ]\n}";
+
+		auto sorted (names);
+		std::sort(sorted.begin(), sorted.end());
+		std::ofstream valid ((dir + "/INSTRUMENTS.valid").c_str());
+		for (std::size_t i = 0; i < sorted.size(); ++i)
+			valid << (i ? "\n" : "") << sorted[i];
+
+		std::ofstream hx ((dir + "/RATES.hx").c_str());
+		for (std::size_t i = 0; i < names.size(); ++i)
+			hx << "\"instrument\" : \"" << names[i] << "\",@"
+			   << "\"time\" : \"2015-02-10T17:16:11.000000Z\",@"
+			   << "\"bid\" : " << format(m.instruments[i].bid) << ",@"
+			   << "\"ask\" : " << format(m.instruments[i].ask) << '\n';
+		if (!json || !valid || !hx)
+			throw std::runtime_error("can't write fixtures to " + dir);
+	}
+}
+
+int main(int argc, char** argv) {
+	for (int i = 1; i < argc; ++i) {
+		if (ARGCHK(argv[i], "-n") && i + 1 < argc)
+			options.currencies = std::strtoul(argv[++i], nullptr, 10);
+		else if (ARGCHK(argv[i], "-d") && i + 1 < argc)
+			options.density = std::strtod(argv[++i], nullptr);
+		else if (ARGCHK(argv[i], "-s") && i + 1 < argc)
+			options.spread = std::strtod(argv[++i], nullptr);
+		else if (ARGCHK(argv[i], "-v") && i + 1 < argc)
+			options.spread_sigma = std::strtod(argv[++i], nullptr);
+		else if (ARGCHK(argv[i], "-c") && i + 1 < argc) {
+			char* end;
+			auto length = std::strtoul(argv[++i], &end, 10);
+			double profit = (*end == ':') ? std::strtod(end + 1, nullptr) : 0.01;
+			options.cycles.push_back(std::make_pair(length, profit));
+		} else if (ARGCHK(argv[i], "-r") && i + 1 < argc)
+			options.seed = static_cast<unsigned>(std::strtoul(argv[++i], nullptr, 10));
+		else if (ARGCHK(argv[i], "-o") && i + 1 < argc)
+			options.dir = argv[++i];
+		else {
+			std::cerr << "gen-market: bad argument " << argv[i] << std::endl;
+			return 1;
+		}
+	}
+	if (options.currencies < 2)
+		throw std::invalid_argument("need at least 2 currencies");
+
+	std::mt19937 rng (options.seed);
+	Market market (rng);
+	std::vector<std::vector<std::size_t>> planted;
+	for (auto const& c : options.cycles)
+		planted.push_back(market.plant(c.first, c.second));
+
+	for (auto const& instr : market.instruments)
+		std::cout << market.name(instr) << ' ' << format(instr.bid) << ' ' << format(instr.ask) << '\n';
+	std::cout.flush();
+
+	std::ofstream planted_file;
+	if (!options.dir.empty()) {
+		write_fixtures(market, options.dir);
+		planted_file.open((options.dir + "/PLANTED").c_str());
+	}
+	std::ostream& report = options.dir.empty() ? std::cerr : planted_file;
+	// Log-rates are of the final quotes, so cycles sharing instruments are accounted for.
+	for (auto const& cycle : planted) {
+		for (auto v : cycle)
+			report << market.names[v] << ';';
+		report << market.names[cycle.front()] << ' ' << market.lrate(cycle) << '\n';
+	}
+
+	return 0;
+}
@@ -10,13 +10,16 @@
 #include <ostream>
 #include <fstream>
 #include <array>
+#include <exception>
+#include <future>
 #include <unordered_map>
+#include <unordered_set>
 #include <string>
 #include <stdexcept>
 #include <sstream>
 #include <vector>
 #include <algorithm>
-#include <boost/algorithm/string/join.hpp>
+#include <cstring>
 
 #include <http.hh>
 
@@ -45,17 +48,59 @@ namespace {
 		return text;
 	}
 
+	// Fixtures, loaded once and kept in the form they're served in.
+	struct Fixtures {
+		// INSTRUMENTS.json, verbatim
+		std::string instruments;
+		// valid instrument names, from INSTRUMENTS.valid
+		std::unordered_set<std::string> valid;
+		// pre-rendered entry of the "prices" array, by instrument, from RATES.hx
+		std::unordered_map<std::string, std::string> prices;
+
+		Fixtures()
+		{
+			std::stringstream ss;
+			for (auto&& line : read_text_file("INSTRUMENTS.json"))
+				ss << std::move(line) << '\n';
+			instruments = ss.str();
+
+			for (auto&& line : read_text_file("INSTRUMENTS.valid"))
+				valid.insert(std::move(line));
+
+			// RATES.hx lines are '@'-separated fields of a price object, the first one
+			// being "instrument" : "NAME",
+			for (auto const& entry : read_text_file("RATES.hx")) {
+				auto name_end = entry.find('"', 16);
+				if (entry.size() < 16 || name_end == std::string::npos)
+					continue;
+				std::string price ("\t\t{""\n\t\t\t");
+				decltype(entry.find(char())) index1 = 0;
+				auto index2 = entry.find('@', index1 + 1);
+				while (index2 != std::string::npos) {
+					price.append(entry, index1, index2 - index1);
+					price += "\n\t\t\t";
+					index1 = index2 + 1;
+					index2 = entry.find('@', index1 + 1);
+				}
+				price.append(entry, index1, std::string::npos);
+				price += "\n\t\t}";
+				prices.emplace(entry.substr(16, name_end - 16), std::move(price));
+			}
+		}
+	};
+
+	Fixtures const& fixtures()
+	{
+		static Fixtures const f;
+		return f;
+	}
+
 	// Read the JSON contained in instruments filename (a json dump) to a string
 	// Used for mock-testing the http input in instrs-ls
 	std::string do_instruments()
 	{
-		static std::string const filename ("INSTRUMENTS.json");
 		++call_count["do_instruments"];
-		std::stringstream ss;
-		for (auto&& line : read_text_file(filename)) {
-			ss << std::move(line) << '\n';
-		}
-		return ss.str();
+		return fixtures().instruments;
 	}
 
 	// Validate the query instruments list to ensure they're valid by comparing against the instruments file.
@@ -64,11 +109,9 @@ namespace {
 	//                              throwing std::invalid_argument if remote end returns HTTP 400 Bad request.
 	void validate_instruments(std::vector<std::string> const& instruments)
 	{
-		// Note: Given it's not intended for it to be called repeatedly,
-		//       there is no caching logic whatsoever here.
-		std::vector<std::string> valid (read_text_file("INSTRUMENTS.valid"));
+		auto const& valid = fixtures().valid;
 		for (auto const& instrument : instruments) {
-			if (!std::binary_search(valid.begin(), valid.end(), instrument))
+			if (!valid.count(instrument))
 				throw std::invalid_argument("Invalid instrument <" + instrument + ">");
 		}
 
@@ -81,37 +124,27 @@ namespace {
 		static std::string const rates_json_footer ("\t]\n"
 							    "}");
 		validate_instruments(instruments);
-		std::vector<std::string> rates_x (read_text_file("RATES.hx"));
-		std::stringstream out;
-		std::vector<std::string> prices;
-
+		auto const& prices = fixtures().prices;
+		std::vector<std::string const*> entries;
+		entries.reserve(instruments.size());
+		std::size_t size = rates_json_header.size() + rates_json_footer.size();
 		for (auto const& instrument : instruments) {
-			// find entry by comparing the instrument part of the quasi-json
-			auto entry = std::find_if(rates_x.begin(), rates_x.end(),
-						[&instrument] (std::string const& e) {
-							if (e.find('"', 16) != (16 + instrument.size()))
-								return false;
-							return e.compare(16, instrument.size(), instrument) == 0;
-						});
-			if (entry == rates_x.end())
+			auto entry = prices.find(instrument);
+			if (entry == prices.end())
 				throw std::logic_error("Unexpected invalid entry: <" + instrument + ">");
-			std::stringstream price_entry;
-			decltype(instrument.find(char())) index1 = 0;
-			auto index2 = entry->find('@', index1 + 1);
-			price_entry << "\t\t{""\n\t\t\t";
-			while (index2 != std::string::npos) {
-				price_entry << entry->substr(index1, index2 - index1) << "\n\t\t\t";
-				index1 = index2 + 1;
-				index2 = entry->find('@', index1 + 1);
-			}
-			price_entry << entry->substr(index1);
-			price_entry << "\n\t\t}";
-			prices.push_back(price_entry.str());
+			entries.push_back(&entry->second);
+			size += entry->second.size() + 1;
+		}
+		std::string out;
+		out.reserve(size);
+		out += rates_json_header;
+		for (auto entry = entries.begin(); entry != entries.end(); ++entry) {
+			if (entry != entries.begin())
+				out += ',';
+			out += **entry;
 		}
-		out << rates_json_header
-		    << boost::algorithm::join(prices, ",")
-		    << rates_json_footer;
-		return out.str();
+		out += rates_json_footer;
+		return out;
 	}
 }
 
@@ -146,3 +179,122 @@ std::string http::query(std::array<std::string, 3> uri) {
 	} else
 		throw std::invalid_argument("Bad URL \"" + uri[2] + "\"");
 }
+
+// The mock has no I/O to stream: the consumer gets the whole body in one piece.
+void http::query(http::Uri const& uri, http::Body_consumer consumer) {
+	auto body = http::query(uri);
+	consumer(body.data(), body.size());
+}
+
+// The mock has no I/O to overlap: the handler runs before async_query returns.
+void http::async_query(http::Uri const& uri, http::Handler handler) {
+	std::string body;
+	try {
+		body = http::query(uri);
+	} catch (...) {
+		return handler(std::current_exception(), std::string());
+	}
+	handler(std::exception_ptr(), std::move(body));
+}
+
+std::future<std::string> http::async_query(http::Uri const& uri) {
+	std::promise<std::string> promise;
+	try {
+		promise.set_value(http::query(uri));
+	} catch (...) {
+		promise.set_exception(std::current_exception());
+	}
+	return promise.get_future();
+}
+
+void http::async_query(http::Uri const& uri, http::Body_consumer consumer, http::Completion done) {
+	try {
+		http::query(uri, std::move(consumer));
+	} catch (...) {
+		return done(std::current_exception());
+	}
+	done(std::exception_ptr());
+}
+
+// Writer side of Response; the real one lives in http.cc, which isn't linked with the mock.
+struct http::detail::Response_access {
+	static void assign(Response& r, unsigned code, std::string const& head, std::string const& body)
+	{
+		r.clear();
+		auto size = head.size() + body.size();
+		if (r.cap < size) {
+			r.buf.reset(new char[size]);
+			r.cap = size;
+		}
+		std::memcpy(r.buf.get(), head.data(), head.size());
+		std::memcpy(r.buf.get() + head.size(), body.data(), body.size());
+		r.size = r.body_end = size;
+		r.status_end = head.find("\r\n");
+		r.headers_end = head.size();
+		r.code = code;
+	}
+};
+
+// The instruments fixture carries a fixed ETag, so that conditional requests can be exercised.
+bool http::query(http::Uri const& uri, http::Validators const& validators, http::Response& response) {
+	static std::string const etag ("\"mock-instruments\"");
+	bool instruments = (uri[2] == "/v1/instruments");
+	if (instruments && validators.etag == etag) {
+		detail::Response_access::assign(response, 304,
+			"HTTP/1.1 304 Not Modified\r\nETag: " + etag + "\r\n\r\n", std::string());
+		return false;
+	}
+	auto body = http::query(uri);
+	detail::Response_access::assign(response, 200,
+		"HTTP/1.1 200 OK\r\n" + (instruments ? "ETag: " + etag + "\r\n" : std::string()) + "\r\n", body);
+	return true;
+}
+
+void http::async_query(http::Uri const& uri, http::Validators const& validators, http::Response& response,
+		       http::Completion done) {
+	try {
+		http::query(uri, validators, response);
+	} catch (...) {
+		return done(std::current_exception());
+	}
+	done(std::exception_ptr());
+}
+
+// As the streamed query, the consumer gets the whole body in one piece; it's also left in `response`.
+bool http::query(http::Uri const& uri, http::Validators const& validators, http::Response& response,
+		 http::Body_consumer consumer) {
+	if (!http::query(uri, validators, response))
+		return false;
+	auto body = response.body();
+	consumer(body.data(), body.size());
+	return true;
+}
+
+void http::async_query(http::Uri const& uri, http::Validators const& validators, http::Response& response,
+		       http::Body_consumer consumer, http::Completion done) {
+	try {
+		http::query(uri, validators, response, std::move(consumer));
+	} catch (...) {
+		return done(std::current_exception());
+	}
+	done(std::exception_ptr());
+}
+
+// The mock does no I/O, so there are no phases to time: the histograms stay empty.
+http::Phase_stats http::phase_stats() {
+	return Phase_stats();
+}
+
+std::ostream& http::operator<< (std::ostream& os, Phase_stats const& stats) {
+	auto line = [&os] (char const* name, Histogram const& h) {
+		os << name << " count=" << h.count << " mean=" << (h.count ? h.sum / h.count : 0)
+		   << " p50=" << h.percentile(50) << " p90=" << h.percentile(90)
+		   << " p99=" << h.percentile(99) << " max=" << h.max << '\n';
+	};
+	line("resolve", stats.resolve);
+	line("connect", stats.connect);
+	line("ttfb", stats.ttfb);
+	line("body", stats.body);
+	line("bytes", stats.bytes);
+	return os;
+}
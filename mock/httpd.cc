@@ -0,0 +1,311 @@
+//          Copyright Andrey Moshbear 2014-2015.
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file LICENSE_1_0.txt or copy at
+//          http://www.boost.org/LICENSE_1_0.txt)
+//
+// Loopback stand-in for the sandbox servers, serving the mock fixtures over HTTP/1.1.
+// Unlike mock/http.cc, the real http module is used against it, sockets and all.
+
+// Args: optional, in any order
+//	-p PORT listens on 127.0.0.1:PORT; default 8080
+//	-s makes /v1/prices a price stream rather than a snapshot
+//	-i MS is the interval between streamed ticks; default 100
+//	-n COUNT ends each stream after COUNT ticks; default unlimited
+//	-l MS delays each response by MS milliseconds
+//	-j MS adds a uniformly random delay of up to MS milliseconds to each response
+//	-b RATE throttles responses to RATE bytes per second
+//	-x PCT drops the connection, at a random point of the response, for PCT% of requests
+//	-c SIZE sends responses chunked, in chunks of SIZE bytes
+//	-r SEED seeds the random choices; each connection gets its own sequence
+// Serves: /v1/instruments from mock/INSTRUMENTS.json
+//	   /v1/prices?instruments=A%2CB... from mock/RATES.hx; unknown instruments get a 400
+// Streams carry one tick per chunk, each tick moving the quote by a small random step,
+// and a heartbeat after every round of the subscribed instruments.
+//
+// Point the http module at it with CURREX_HTTP_ENDPOINT=localhost:PORT.
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <exception>
+#include <map>
+#include <random>
+#include <string>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+#include <boost/asio.hpp>
+
+using boost::asio::ip::tcp;
+
+#define ARGCHK(x,a) !strncmp(x, a, sizeof a)
+
+namespace {
+
+	std::string const fixpath ("mock/");
+
+	struct Options {
+		unsigned short port = 8080;
+		bool stream = false;
+		unsigned interval_ms = 100;
+		unsigned long long count = 0;
+		unsigned latency_ms = 0;
+		unsigned jitter_ms = 0;
+		unsigned long long rate = 0;
+		double drop_pct = 0;
+		std::size_t chunk_size = 0;
+		unsigned seed = 1;
+	} options;
+
+	// connections accepted so far; picks the random sequence of each
+	std::atomic<unsigned> sessions { 0 };
+
+	struct Quote {
+		std::string instrument;
+		std::string time;
+		double bid;
+		double ask;
+	};
+
+	std::string read_file(std::string const& filename)
+	{
+		std::ifstream in((fixpath + filename).c_str());
+		if (!in)
+			throw std::runtime_error("can't open " + fixpath + filename);
+		std::stringstream ss;
+		ss << in.rdbuf();
+		return ss.str();
+	}
+
+	// Value of `"name" : value` in a RATES.hx line, without quotes
+	std::string hx_field(std::string const& line, std::string const& name)
+	{
+		auto key = line.find('"' + name + '"');
+		if (key == std::string::npos)
+			throw std::runtime_error("RATES.hx: no " + name + " in " + line);
+		auto begin = line.find_first_not_of(" :\"", key + name.size() + 2);
+		auto end = line.find_first_of("\",@", begin);
+		return line.substr(begin, end == std::string::npos ? end : end - begin);
+	}
+
+	// Fixture quotes, by instrument
+	std::map<std::string, Quote> load_quotes()
+	{
+		std::map<std::string, Quote> quotes;
+		std::istringstream in (read_file("RATES.hx"));
+		std::string line;
+		while (std::getline(in, line)) {
+			if (line.empty())
+				continue;
+			Quote q;
+			q.instrument = hx_field(line, "instrument");
+			q.time = hx_field(line, "time");
+			q.bid = std::strtod(hx_field(line, "bid").c_str(), nullptr);
+			q.ask = std::strtod(hx_field(line, "ask").c_str(), nullptr);
+			quotes[q.instrument] = q;
+		}
+		return quotes;
+	}
+
+	std::string const instruments_json (read_file("INSTRUMENTS.json"));
+	std::map<std::string, Quote> const quotes (load_quotes());
+
+	std::string quote_json(Quote const& q)
+	{
+		std::ostringstream s;
+		// as mock/gen-market writes them (%.10g), so prices keep their digits
+		s.precision(10);
+		s << "{\"instrument\":\"" << q.instrument << "\",\"time\":\"" << q.time
+		  << "\",\"bid\":" << q.bid << ",\"ask\":" << q.ask << '}';
+		return s.str();
+	}
+
+	std::string now()
+	{
+		auto t = std::time(nullptr);
+		char buf[32];
+		std::strftime(buf, sizeof buf, "%Y-%m-%dT%H:%M:%S.000000Z", std::gmtime(&t));
+		return buf;
+	}
+
+	// Instruments of a /v1/prices query string, validated against the fixtures.
+	// Ret: false if there is an unknown instrument
+	bool parse_instruments(std::string const& target, std::vector<Quote>& out)
+	{
+		auto q = target.find("instruments=");
+		if (q == std::string::npos)
+			return false;
+		auto list = target.substr(q + 12);
+		list = list.substr(0, list.find('&'));
+		std::string::size_type begin = 0;
+		for (;;) {
+			auto sep = list.find("%2C", begin);
+			auto it = quotes.find(list.substr(begin, sep == std::string::npos ? sep : sep - begin));
+			if (it == quotes.end())
+				return false;
+			out.push_back(it->second);
+			if (sep == std::string::npos)
+				return !out.empty();
+			begin = sep + 3;
+		}
+	}
+
+	// Send a rendered response: after the configured delay, throttled, and maybe cut short.
+	void transmit(tcp::socket& socket, std::mt19937& rng, std::string const& data)
+	{
+		auto delay = options.latency_ms;
+		if (options.jitter_ms)
+			delay += std::uniform_int_distribution<unsigned>(0, options.jitter_ms - 1)(rng);
+		std::this_thread::sleep_for(std::chrono::milliseconds(delay));
+
+		auto length = data.size();
+		bool drop = (options.drop_pct > 0
+			     && std::uniform_real_distribution<double>(0, 100)(rng) < options.drop_pct);
+		if (drop)
+			length = std::uniform_int_distribution<std::size_t>(0, data.size() - 1)(rng);
+		// 20 slices per second at most, so that the rate holds at a fine grain
+		std::size_t slice = options.rate ? std::max<std::size_t>(options.rate / 20, 1) : length;
+		for (std::size_t sent = 0; sent < length; sent += slice) {
+			auto n = std::min(slice, length - sent);
+			boost::asio::write(socket, boost::asio::buffer(data.data() + sent, n));
+			if (options.rate)
+				std::this_thread::sleep_for(std::chrono::microseconds(n * 1000000 / options.rate));
+		}
+		if (drop)
+			throw std::runtime_error("connection dropped");
+	}
+
+	void respond(tcp::socket& socket, std::mt19937& rng, unsigned code, char const* reason,
+		     std::string const& body)
+	{
+		std::ostringstream out;
+		out << "HTTP/1.1 " << code << ' ' << reason << "\r\n"
+		    << "Content-Type: application/json\r\n";
+		if (options.chunk_size) {
+			out << "Transfer-Encoding: chunked\r\n\r\n" << std::hex;
+			for (std::size_t i = 0; i < body.size(); i += options.chunk_size) {
+				auto n = std::min(options.chunk_size, body.size() - i);
+				out << n << "\r\n";
+				out.write(body.data() + i, static_cast<std::streamsize>(n));
+				out << "\r\n";
+			}
+			out << "0\r\n\r\n";
+		} else {
+			out << "Content-Length: " << body.size() << "\r\n\r\n" << body;
+		}
+		transmit(socket, rng, out.str());
+	}
+
+	void write_chunk(tcp::socket& socket, std::string const& data)
+	{
+		std::ostringstream chunk;
+		chunk << std::hex << data.size() << "\r\n" << data << "\r\n";
+		boost::asio::write(socket, boost::asio::buffer(chunk.str()));
+	}
+
+	// Stream ticks of `subscribed` until the client goes away, or options.count ticks.
+	void stream(tcp::socket& socket, std::mt19937& rng, std::vector<Quote> subscribed)
+	{
+		transmit(socket, rng, "HTTP/1.1 200 OK\r\n"
+			"Content-Type: application/json\r\n"
+			"Transfer-Encoding: chunked\r\n\r\n");
+		std::normal_distribution<double> step (0, 1e-4);
+		for (unsigned long long n = 0; !options.count || n < options.count; ) {
+			for (auto& q : subscribed) {
+				if (options.count && n == options.count)
+					break;
+				auto spread = q.ask - q.bid;
+				q.bid *= 1 + step(rng);
+				q.ask = q.bid + spread;
+				q.time = now();
+				write_chunk(socket, "{\"tick\":" + quote_json(q) + "}\n");
+				++n;
+				std::this_thread::sleep_for(std::chrono::milliseconds(options.interval_ms));
+			}
+			write_chunk(socket, "{\"heartbeat\":{\"time\":\"" + now() + "\"}}\n");
+		}
+		boost::asio::write(socket, boost::asio::buffer(std::string("0\r\n\r\n")));
+	}
+
+	// Serve requests on a connection until the client closes it.
+	void session(tcp::socket socket, unsigned id)
+	{
+		std::mt19937 rng (options.seed + id);
+		try {
+			boost::asio::streambuf buf;
+			for (;;) {
+				boost::asio::read_until(socket, buf, "\r\n\r\n");
+				std::istream in(&buf);
+				std::string method, target, line;
+				in >> method >> target;
+				// rest of the request head; GET requests have no body
+				while (std::getline(in, line) && line != "\r")
+					;
+				if (method != "GET") {
+					respond(socket, rng, 405, "Method Not Allowed", "");
+					continue;
+				}
+				std::vector<Quote> subscribed;
+				if (target == "/v1/instruments") {
+					respond(socket, rng, 200, "OK", instruments_json);
+				} else if (target.compare(0, 11, "/v1/prices?") != 0) {
+					respond(socket, rng, 404, "Not Found", "");
+				} else if (!parse_instruments(target, subscribed)) {
+					respond(socket, rng, 400, "Bad Request", "{\"code\":1,\"message\":\"Invalid instrument\"}");
+				} else if (options.stream) {
+					return stream(socket, rng, std::move(subscribed));
+				} else {
+					std::string body ("{\"prices\":[");
+					for (auto const& q : subscribed)
+						body += quote_json(q) + ',';
+					body.back() = ']';
+					respond(socket, rng, 200, "OK", body + '}');
+				}
+			}
+		} catch (std::exception const&) {
+			// client went away, or the connection was dropped on purpose
+		}
+	}
+}
+
+int main(int argc, char** argv) {
+	for (int i = 1; i < argc; ++i) {
+		if (ARGCHK(argv[i], "-s"))
+			options.stream = true;
+		else if (ARGCHK(argv[i], "-p") && i + 1 < argc)
+			options.port = static_cast<unsigned short>(std::strtoul(argv[++i], nullptr, 10));
+		else if (ARGCHK(argv[i], "-i") && i + 1 < argc)
+			options.interval_ms = static_cast<unsigned>(std::strtoul(argv[++i], nullptr, 10));
+		else if (ARGCHK(argv[i], "-n") && i + 1 < argc)
+			options.count = std::strtoull(argv[++i], nullptr, 10);
+		else if (ARGCHK(argv[i], "-l") && i + 1 < argc)
+			options.latency_ms = static_cast<unsigned>(std::strtoul(argv[++i], nullptr, 10));
+		else if (ARGCHK(argv[i], "-j") && i + 1 < argc)
+			options.jitter_ms = static_cast<unsigned>(std::strtoul(argv[++i], nullptr, 10));
+		else if (ARGCHK(argv[i], "-b") && i + 1 < argc)
+			options.rate = std::strtoull(argv[++i], nullptr, 10);
+		else if (ARGCHK(argv[i], "-x") && i + 1 < argc)
+			options.drop_pct = std::strtod(argv[++i], nullptr);
+		else if (ARGCHK(argv[i], "-c") && i + 1 < argc)
+			options.chunk_size = std::strtoul(argv[++i], nullptr, 10);
+		else if (ARGCHK(argv[i], "-r") && i + 1 < argc)
+			options.seed = static_cast<unsigned>(std::strtoul(argv[++i], nullptr, 10));
+	}
+
+	boost::asio::io_service io_service;
+	tcp::acceptor acceptor(io_service, tcp::endpoint(boost::asio::ip::address_v4::loopback(), options.port));
+	std::cerr << "mock/httpd: " << quotes.size() << " instruments on 127.0.0.1:" << options.port
+		  << (options.stream ? " (streaming)" : "") << std::endl;
+	for (;;) {
+		tcp::socket socket(io_service);
+		acceptor.accept(socket);
+		std::thread(session, std::move(socket), sessions++).detach();
+	}
+}
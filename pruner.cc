@@ -20,30 +20,24 @@
 #include <functional>
 #include <stdexcept>
 #include <type_traits>
+#include <utility>
 
 #include <algo.hh>
 #include <c-print.hh>
 #include <g-common.hh>
 #include <d.hh>
+#include <util.hh>
+#include <symbols.hh>
 #include <pruner.hh>
 
 
 namespace {
-// Directedness-invariant DFS visitor for cycle detection
-	class cycle_detector_t : public bgl::dfs_visitor<> {
-		typedef std::vector<bool> bitvec;
-	public:
-		cycle_detector_t(bitvec& ev_)
-		: ev(ev_) { }
-
-		template <typename Edge, typename Graph>
-		void back_edge(Edge e, const Graph& g) {
-			auto v = bgl::target(e, g);
-			ev.get()[v] = true;
-		}
-	private:
-		std::reference_wrapper<bitvec> ev;
-	};
+	std::vector<std::string> names(std::vector<symbols::Id> const& ids) {
+		std::vector<std::string> out;
+		for (auto id : ids)
+			out.push_back(symbols::name(id));
+		return out;
+	}
 }
 
 using std::vector;
@@ -61,97 +55,226 @@ using std::ref;
 
 typedef bgl::adjacency_list<bgl::vecS, bgl::vecS, bgl::undirectedS> graph;
 
-static const char node_sep = '_';
+namespace {
+	typedef g_common::VE<graph>::Vertex Vertex;
+
+	// vector<bool> peel(graph const&).
+	// Find the vertices outside the 2-core: repeatedly drop vertices of degree < 2.
+	//
+	// Arg: graph const& g - input graph
+	// Ret: marked[v] if v is outside the 2-core
+	vector<bool> peel(graph const& g)
+	{
+		auto n = bgl::num_vertices(g);
+		vector<bool> marked (n, false);
+		vector<size_t> deg (n);
+		vector<Vertex> queue;
+		for (Vertex v = 0; v < n; ++v) {
+			deg[v] = bgl::out_degree(v, g);
+			if (deg[v] < 2)
+				queue.push_back(v);
+		}
+		// each vertex is queued once: when found below 2, or when its degree falls to 1
+		while (!queue.empty()) {
+			auto v = queue.back();
+			queue.pop_back();
+			marked[v] = true;
+			for (auto w : util::pair_to_range(bgl::adjacent_vertices(v, g)))
+				if (!marked[w] && --deg[w] == 1)
+					queue.push_back(w);
+		}
+		return marked;
+	}
+
+	// vector<graph::edge_descriptor> bridges(graph const&).
+	// Find the bridges of a graph: the edges on no cycle. Tarjan's lowpoints, by an iterative DFS.
+	// Parallel edges are a cycle of their own.
+	//
+	// Arg: graph const& g - input graph
+	// Ret: the bridges
+	vector<graph::edge_descriptor> bridges(graph const& g)
+	{
+		auto n = bgl::num_vertices(g);
+		// number the edges, and lay out each vertex's (neighbour, edge number) pairs contiguously
+		vector<graph::edge_descriptor> edges;
+		vector<size_t> first (n + 1, 0);
+		for (auto const& e : util::pair_to_range(bgl::edges(g))) {
+			edges.push_back(e);
+			++first[bgl::source(e, g) + 1];
+			++first[bgl::target(e, g) + 1];
+		}
+		for (Vertex v = 0; v < n; ++v)
+			first[v + 1] += first[v];
+		vector<std::pair<Vertex, size_t>> adj (first[n]);
+		{
+			auto next = first;
+			for (size_t k = 0; k < edges.size(); ++k) {
+				auto u = bgl::source(edges[k], g);
+				auto v = bgl::target(edges[k], g);
+				adj[next[u]++] = { v, k };
+				adj[next[v]++] = { u, k };
+			}
+		}
+
+		static const size_t none = static_cast<size_t>(-1);
+		// discovery times from 1; 0 is unvisited
+		vector<size_t> disc (n, 0);
+		vector<size_t> low (n, 0);
+		size_t time = 0;
+		struct Frame {
+			Vertex v;
+			// edge number we came in by
+			size_t in;
+			// next adj entry to look at
+			size_t next;
+		};
+		vector<Frame> stack;
+		vector<graph::edge_descriptor> out;
+		for (Vertex root = 0; root < n; ++root) {
+			if (disc[root])
+				continue;
+			disc[root] = low[root] = ++time;
+			stack.push_back({ root, none, first[root] });
+			while (!stack.empty()) {
+				auto& f = stack.back();
+				if (f.next < first[f.v + 1]) {
+					auto a = adj[f.next++];
+					if (a.second == f.in)
+						continue;
+					if (disc[a.first]) {
+						low[f.v] = std::min(low[f.v], disc[a.first]);
+					} else {
+						disc[a.first] = low[a.first] = ++time;
+						stack.push_back({ a.first, a.second, first[a.first] });
+					}
+					continue;
+				}
+				auto done = f;
+				stack.pop_back();
+				if (stack.empty())
+					break;
+				auto p = stack.back().v;
+				low[p] = std::min(low[p], low[done.v]);
+				if (low[done.v] > disc[p])
+					out.push_back(edges[done.in]);
+			}
+		}
+		return out;
+	}
+}
 
 
 vector<string> pruner(vector<string> const& input) {
+	vector<symbols::Instrument> instruments;
+	for (auto const& line : input) {
+		try {
+			instruments.push_back(symbols::intern_instrument(line));
+		} catch (invalid_argument&) {
+			throw invalid_argument("Bad input");
+		}
+	}
+	vector<string> output;
+	for (auto const& uv : pruner(instruments))
+		output.push_back(symbols::name(uv));
+	return output;
+}
+
+vector<symbols::Instrument> pruner(vector<symbols::Instrument> const& input) {
 	D_push_id(pruner);
 
 	// graph construction
-	vector<string> nodes;
-	vector<string> output;
+	// vertex -> currency id
+	vector<symbols::Id> nodes;
+	vector<symbols::Instrument> output;
 
-	vector<array<string, 2>> unparsed;
-	vector<array<g_common::VE<graph>::Vertex, 2>> edges;
+	vector<std::pair<g_common::VE<graph>::Vertex, g_common::VE<graph>::Vertex>> edges;
+	edges.reserve(input.size());
 
 	D_print(D_info, cerr, "load graph");
 
-	for (auto const& line : input) {
-		auto pos = line.find(node_sep);
-		if (pos == std::remove_reference<decltype(line)>::type::npos || pos == 0 || pos == (line.size() - 1))
-			throw invalid_argument("Bad input");
-		string u = line.substr(0, pos);
-		string v = line.substr(pos + 1);
-		unparsed.push_back({{u, v}});
-		// find the corresponding node numbers
-		decltype(nodes)::difference_type upos, vpos, npos;
-		npos = algo::npos<decltype(nodes)>::value;
-		if ((upos = algo::index_of(nodes, u)) == npos) {
-			upos = util::checked_cast<decltype(upos)>(nodes.size());
-			nodes.push_back(u);
-		}
-		if ((vpos = algo::index_of(nodes, v)) == npos) {
-			vpos = util::checked_cast<decltype(vpos)>(nodes.size());
-			nodes.push_back(v);
+	// currency id -> vertex, or npos; ids are dense, so a vector serves as the index
+	typedef decltype(nodes)::difference_type Diff;
+	static const Diff npos = algo::npos<decltype(nodes)>::value;
+	vector<Diff> vertex_of (symbols::size(), npos);
+	auto vertex = [&] (symbols::Id id) {
+		if (id >= vertex_of.size())
+			vertex_of.resize(id + 1, npos);
+		if (vertex_of[id] == npos) {
+			vertex_of[id] = util::checked_cast<Diff>(nodes.size());
+			nodes.push_back(id);
 		}
+		return vertex_of[id];
+	};
+
+	for (auto const& uv : input) {
+		// find the corresponding node numbers
+		auto upos = vertex(uv.base);
+		auto vpos = vertex(uv.quote);
 		D_print(D_trace, cerr, [&] { stringstream s;
-					s << "Load edge: " << u << node_sep << v << " -> [" << upos << "]->[" << vpos << "]";
+					s << "Load edge: " << symbols::name(uv) << " -> [" << upos << "]->[" << vpos << "]";
 					return string(s.str()); }());
 		// load edge into graph
-		edges.push_back({{g_common::VE<graph>::V(upos), g_common::VE<graph>::V(vpos)}});
+		edges.emplace_back(g_common::VE<graph>::V(upos), g_common::VE<graph>::V(vpos));
 	}
 
-
 	D_eval(D_trace, std::cerr << D_add_context(D_trace) << ' '
-				  << c_print::printer(nodes, "Nodes") << '\n');
+				  << c_print::printer(names(nodes), "Nodes") << '\n');
 
-	graph g;
-	for (const auto& e: edges) 
-		bgl::add_edge(e[0], e[1], g);
+	// O(E): the vertex count is known up front
+	graph g (edges.begin(), edges.end(), nodes.size());
 
 	D_eval(D_trace, g_common::to_gv_dotfile(g, "pre.dot"));
 
 	vector<string> removed;
-	D_print(D_info, cerr, "pre-prune lone vertices");
-	for (auto v_end = bgl::num_vertices(g), v = v_end - 1; v < v_end; --v) {
-		auto d = g_common::degree(g, v);
-		if (d[0] < 2 && d[1] < 2) {
-			bgl::clear_vertex(v, g);
-			bgl::remove_vertex(v, g);
-			removed.push_back(nodes[util::checked_cast<decltype(nodes)::size_type>(v)]);
-			algo::erase_at(nodes, util::checked_cast<decltype(nodes)::difference_type>(v));
-		}
+	auto report = [&] (char const* step, size_t vertices, size_t edges) {
+		D_print(D_info, cerr, [&] { stringstream s;
+					s << step << ": removed " << vertices << " vertices, " << edges << " edges; "
+					  << bgl::num_vertices(g) << " vertices, " << bgl::num_edges(g) << " edges left";
+					return string(s.str()); }());
+	};
+
+	// Vertices outside the 2-core are on no cycle: peeling gets rid of trees hanging off the rest
+	D_print(D_info, cerr, "peel to the 2-core");
+	auto marked = peel(g);
+	{
+		auto v_before = bgl::num_vertices(g);
+		auto e_before = bgl::num_edges(g);
+		D_eval(D_trace, for (size_t v = 0; v < marked.size(); ++v)
+					if (marked[v])
+						removed.push_back(symbols::name(nodes[v])));
+		g_common::remove_vertices(g, marked);
+		algo::erase_marked(nodes, marked);
+		report("2-core", v_before - bgl::num_vertices(g), e_before - bgl::num_edges(g));
 	}
 	D_eval(D_trace, std::cerr << D_add_context(D_trace) << ' '
 				  << c_print::printer(removed, "Removed vertices") << '\n');
 	removed.clear();
 
-	// cycle detection
-	D_print(D_info, cerr, "find cycles");
-
-	vector<bool> cyclic(bgl::num_vertices(g), false);
-	cycle_detector_t cycle_detector(cyclic);
-
-	bgl::depth_first_search(g, visitor(cycle_detector));
-
-	D_print(D_info, cerr, "prune acyclics");
-
-
-	// prune in reverse direction since bgl invalidates vertex descriptors following on removal
-	for (auto v_end = cyclic.size(), v = v_end - 1; v < v_end; --v) 
-		if (!cyclic[v]) {
-			bgl::clear_vertex(v, g);
-			bgl::remove_vertex(v, g);
-			removed.push_back(nodes[util::checked_cast<decltype(nodes)::size_type>(v)]);
-			algo::erase_at(nodes, util::checked_cast<decltype(nodes)::difference_type>(v));
-		}
+	// What's left may still have bridges, e.g. paths between cycles: they are on no cycle either,
+	// and neither are vertices left with nothing else
+	D_print(D_info, cerr, "remove bridges");
+	{
+		auto v_before = bgl::num_vertices(g);
+		auto e_before = bgl::num_edges(g);
+		for (auto const& e : bridges(g))
+			bgl::remove_edge(e, g);
+		marked.assign(bgl::num_vertices(g), false);
+		for (Vertex v = 0; v < marked.size(); ++v)
+			if (!bgl::out_degree(v, g)) {
+				marked[v] = true;
+				D_eval(D_trace, removed.push_back(symbols::name(nodes[v])));
+			}
+		g_common::remove_vertices(g, marked);
+		algo::erase_marked(nodes, marked);
+		report("bridges", v_before - bgl::num_vertices(g), e_before - bgl::num_edges(g));
+	}
 
 	// print output
 	D_eval(D_trace, std::cerr << D_add_context(D_trace) << ' '
 				  << c_print::printer(removed, "Removed vertices") << '\n');
 
 	D_eval(D_trace, std::cerr << D_add_context(D_trace) << ' '
-				  << c_print::printer(nodes, "New vertices") << '\n');
+				  << c_print::printer(names(nodes), "New vertices") << '\n');
 	D_eval(D_trace, g_common::to_gv_dotfile(g, "post.dot"));
 	vector<array<std::string, 2>> new_edges;
 	auto es = bgl::edges(g);
@@ -159,10 +282,10 @@ vector<string> pruner(vector<string> const& input) {
 		auto u_id = bgl::source(*eit, g);
 		auto v_id = bgl::target(*eit, g);
 		try { // UB Paranoia.
-			const auto& u = nodes.at(u_id);
-			const auto& v = nodes.at(v_id);
-			output.push_back(u + node_sep + v);
-			new_edges.push_back({{u, v}});
+			auto u = nodes.at(u_id);
+			auto v = nodes.at(v_id);
+			output.push_back({ u, v });
+			D_eval(D_trace, new_edges.push_back({{ symbols::name(u), symbols::name(v) }}));
 		} catch (out_of_range&) {
 			D_print(D_err, cerr, [&] { stringstream s;
 						s << "**UB** edge [" << u_id << "]->[" << v_id << "]";
@@ -3,9 +3,10 @@
 //    (See accompanying file LICENSE_1_0.txt or copy at
 //          http://www.boost.org/LICENSE_1_0.txt)
 //
-// A pruner that eliminates acyclic vertices from the edge list defined by
-// the input.
-// The new edge list is returned as a vector.
+// A pruner that eliminates the vertices and edges on no cycle from the edge list
+// defined by the input: those outside the 2-core, then bridges and the vertices
+// they leave bare. Both passes are O(V+E).
+// The new edge list is returned as a vector, in input order.
 
 #ifndef PRUNER_HH
 #define PRUNER_HH
@@ -13,9 +14,14 @@
 #include <vector>
 #include <string>
 
+#include <symbols.hh>
+
 // Prune a graph described by an edge list in input and return the
 // pruned graph's edge list as output.
 // Graph is assumed to be undirected.
 std::vector<std::string> pruner(std::vector<std::string> const& in);
 
+// As above, for instruments already interned in symbols.
+std::vector<symbols::Instrument> pruner(std::vector<symbols::Instrument> const& in);
+
 #endif
@@ -3,77 +3,456 @@
 //    (See accompanying file LICENSE_1_0.txt or copy at
 //          http://www.boost.org/LICENSE_1_0.txt)
 //
-// Linking dependencies: -ljson-c -lboost_system
+// Linking dependencies: -lboost_system -lpthread -lz
 
 // Implementation detail of rates
 
 // parts from http://www.boost.org/doc/html/boost_asio/example/cpp03/http/client/sync_client.cpp
-// parts from http://stackoverflow.com/a/16976703/982617
 
+#include <algorithm>
 #include <array>
+#include <atomic>
+#include <cstddef>
+#include <exception>
+#include <functional>
+#include <future>
 #include <memory>
+#include <mutex>
 #include <string>
 #include <stdexcept>
 #include <vector>
 
 #include <http.hh>
+#include <decimal.hh>
 #include <rates.hh>
 
-extern "C" {
-#include <json-c/json.h>
-}
-
 namespace {
 
-	std::vector<rates::Rate> parse_json(const std::string& data) {
-		using rates::Rate;
-		typedef json_object* J_obj; // non-refcounted json_object
-		std::vector<Rate> result;
+	// Price_parser.
+	// Single-pass, incremental parser of a price response:
+	//	{ "prices" : [ { "instrument" : "X_Y", "bid" : 1.0, "ask" : 1.1, ... }, ... ] }
+	// Fed body pieces as they arrive; each rate is appended to the output as its object
+	// closes. Everything else is checked for well-formedness and skipped, without a tree
+	// being built. Strings and numbers are only kept while being scanned, in a buffer
+	// which is reused across tokens.
+	class Price_parser {
+	public:
+		explicit Price_parser(std::vector<rates::Rate>& out_)
+		: out(out_), state(State::value), prices_seen(false), in_prices(false)
+		{ }
 
-		struct JsonC_deleter { // json_object refcount decrementer
-			void operator() (json_object* o) const
-			{ json_object_put(o); }
-		};
+		void operator() (char const* data, std::size_t n) {
+			char const* end = data + n;
+			for (char const* p = data; p != end; ) {
+				switch (state) {
+				case State::string:
+					p = scan_string(p, end);
+					break;
+				case State::number:
+				case State::literal:
+					p = scan_word(p, end);
+					break;
+				default:
+					token_start(*p++);
+					break;
+				}
+			}
+		}
 
-		// json bits adapted from json-c array answer on SO and json-c docs
-		std::shared_ptr<json_object> j_rootobj(json_tokener_parse(data.c_str()), JsonC_deleter());
-		
-		auto json_try_get = [] (J_obj root, const char* name) -> J_obj {
-			J_obj val;
-			if (!json_object_object_get_ex(root, name, &val))
-				throw std::invalid_argument(std::string("JSON error: \"") + name + "\" not found");
-			return val;
-		};
+		// Check that a whole document has been seen.
+		void finish() {
+			// a number at the very end of the input has nothing after it to end it
+			if (state == State::number || state == State::literal)
+				end_word();
+			if (state != State::done)
+				throw std::invalid_argument("JSON error: incomplete document");
+			if (!prices_seen)
+				throw std::invalid_argument("JSON error: \"prices\" not found");
+		}
 
-		auto j_prices = json_try_get(j_rootobj.get(), "prices");
-		auto nprices = json_object_array_length(j_prices);
-		for (auto i = 0; i < nprices; ++i) {
-			auto j_price = json_object_array_get_idx(j_prices, i);
-			result.push_back(Rate(
-				json_object_get_string(json_try_get(j_price, "instrument")),
-				json_object_get_double(json_try_get(j_price, "bid")),
-				json_object_get_double(json_try_get(j_price, "ask"))
-			));
+	private:
+		enum class State { value, after_value, key, colon, string, number, literal, done };
+		// What a string being scanned is
+		enum class Role { key, value };
+		// Member of a price object a value is for
+		enum class Field { none, instrument, bid, ask };
+
+		std::vector<rates::Rate>& out;
+		State state;
+		Role role;
+		bool escape = false;
+		// enclosing objects '{' and arrays '['
+		std::vector<char> nesting;
+		// key of the member whose value comes next
+		Field field = Field::none;
+		bool prices_key = false;
+		bool prices_seen;
+		// inside the prices array
+		bool in_prices;
+		std::string token;
+		// price object being parsed
+		std::string instrument;
+		double bid = 0, ask = 0;
+		// bit set of instrument, bid, ask having been seen in the price object
+		unsigned char have = 0;
+		// an opening bracket was the last token
+		bool empty_container = false;
+
+		static bool is_space(char c)
+		{ return c == ' ' || c == '\t' || c == '\n' || c == '\r'; }
+
+		[[noreturn]] static void error(char const* what)
+		{ throw std::invalid_argument(std::string("JSON error: ") + what); }
+
+		// depth of a price object: root object, prices array, price object
+		bool in_price() const
+		{ return in_prices && nesting.size() == 3; }
+
+		void token_start(char c) {
+			if (is_space(c))
+				return;
+			bool was_empty = empty_container;
+			empty_container = false;
+			switch (state) {
+			case State::value:
+				if (c == '{' || c == '[') {
+					open(c);
+				} else if (c == ']' && was_empty) {
+					close(c);
+				} else if (c == '"') {
+					role = Role::value;
+					token.clear();
+					state = State::string;
+				} else if (c == '-' || (c >= '0' && c <= '9')) {
+					token.assign(1, c);
+					state = State::number;
+				} else if (c == 't' || c == 'f' || c == 'n') {
+					token.assign(1, c);
+					state = State::literal;
+				} else {
+					error("unexpected character");
+				}
+				break;
+			case State::key:
+				if (c == '"') {
+					role = Role::key;
+					token.clear();
+					state = State::string;
+				} else if (c == '}' && was_empty) {
+					close(c);
+				} else {
+					error("expected member name");
+				}
+				break;
+			case State::colon:
+				if (c != ':')
+					error("expected ':'");
+				state = State::value;
+				break;
+			case State::after_value:
+				if (nesting.empty())
+					error("trailing data");
+				if (c == ',')
+					state = (nesting.back() == '{') ? State::key : State::value;
+				else if (c == '}' || c == ']')
+					close(c);
+				else
+					error("expected ',' or end of container");
+				break;
+			case State::done:
+				error("trailing data");
+			default:
+				break;
+			}
 		}
-		return result;
-	}
-	
-	std::array<std::string, 3> make_query_url(std::vector<std::string> const& instrs) {
-		if (!instrs.size())
+
+		void open(char c) {
+			if (c == '[' && prices_key && nesting.size() == 1) {
+				in_prices = true;
+				prices_seen = true;
+			} else if (c == '{' && in_prices && nesting.size() == 2) {
+				have = 0;
+			}
+			prices_key = false;
+			field = Field::none;
+			nesting.push_back(c);
+			state = (c == '{') ? State::key : State::value;
+			empty_container = true;
+		}
+
+		void close(char c) {
+			if (nesting.empty() || nesting.back() != (c == '}' ? '{' : '['))
+				error("mismatched bracket");
+			if (c == '}' && in_price())
+				emit();
+			nesting.pop_back();
+			if (c == ']' && in_prices && nesting.size() == 1)
+				in_prices = false;
+			end_value();
+		}
+
+		void end_value() {
+			field = Field::none;
+			prices_key = false;
+			state = nesting.empty() ? State::done : State::after_value;
+		}
+
+		void emit() {
+			if (!(have & 1))
+				error("\"instrument\" not found");
+			if (!(have & 2))
+				error("\"bid\" not found");
+			if (!(have & 4))
+				error("\"ask\" not found");
+			out.emplace_back(instrument, bid, ask);
+		}
+
+		char const* scan_string(char const* p, char const* end) {
+			char const* run = p;
+			for (; p != end; ++p) {
+				char c = *p;
+				if (escape) {
+					escape = false;
+					switch (c) {
+					case '"': case '\\': case '/': token += c; break;
+					case 'b': token += '\b'; break;
+					case 'f': token += '\f'; break;
+					case 'n': token += '\n'; break;
+					case 'r': token += '\r'; break;
+					case 't': token += '\t'; break;
+					// \uXXXX is kept verbatim; names and numbers are ASCII
+					case 'u': token += "\\u"; break;
+					default: error("bad escape in string");
+					}
+					run = p + 1;
+				} else if (c == '\\') {
+					token.append(run, p);
+					escape = true;
+				} else if (c == '"') {
+					token.append(run, p);
+					end_string();
+					return p + 1;
+				} else if (static_cast<unsigned char>(c) < 0x20) {
+					error("control character in string");
+				}
+			}
+			token.append(run, p);
+			return p;
+		}
+
+		void end_string() {
+			if (role == Role::key) {
+				field = Field::none;
+				prices_key = false;
+				if (nesting.size() == 1)
+					prices_key = (token == "prices");
+				else if (in_price())
+					field = (token == "instrument") ? Field::instrument
+					      : (token == "bid") ? Field::bid
+					      : (token == "ask") ? Field::ask
+					      : Field::none;
+				state = State::colon;
+				return;
+			}
+			if (field == Field::instrument) {
+				instrument.swap(token);
+				have |= 1;
+			} else if (field == Field::bid || field == Field::ask) {
+				error("expected a number");
+			}
+			end_value();
+		}
+
+		static bool is_word_char(char c)
+		{ return (c >= '0' && c <= '9') || (c >= 'a' && c <= 'z') || c == '.' || c == '-' || c == '+' || c == 'E'; }
+
+		char const* scan_word(char const* p, char const* end) {
+			char const* run = p;
+			while (p != end && is_word_char(*p))
+				++p;
+			token.append(run, p);
+			if (p != end)
+				end_word();
+			return p;
+		}
+
+		void end_word() {
+			if (state == State::literal) {
+				if (token != "true" && token != "false" && token != "null")
+					error("bad literal");
+				if (field != Field::none)
+					error("unexpected literal in price");
+				return end_value();
+			}
+			double d = 0;
+			char const* num_end = token.data() + token.size();
+			if (decimal::parse(token.data(), num_end, d) != num_end)
+				error("bad number");
+			if (field == Field::bid) {
+				bid = d;
+				have |= 2;
+			} else if (field == Field::ask) {
+				ask = d;
+				have |= 4;
+			} else if (field == Field::instrument) {
+				error("expected a string");
+			}
+			end_value();
+		}
+	};
+
+	typedef std::vector<std::string>::const_iterator Instr_iter;
+
+	std::string const query_base("/v1/prices?instruments=");
+	std::string const query_sep("%2C");
+
+	std::array<std::string, 3> make_query_url(Instr_iter begin, Instr_iter end) {
+		if (begin == end)
 			throw std::invalid_argument("empty vector");
 		std::string prot("http");
 		std::string domain("api-sandbox.oanda.com");
-		std::string q("/v1/prices?instruments=");
-		for (auto const& instr : instrs) {
-			q += instr;
-			q += "%2C";
+		std::string q(query_base);
+		for (auto instr = begin; instr != end; ++instr) {
+			q += *instr;
+			q += query_sep;
 		}
-		q.resize(q.size() - 3);
+		q.resize(q.size() - query_sep.size());
 		return {{ prot, domain, q }};
 	}
+
+	// Length of the query string make_query_url would produce for [begin, end)
+	std::size_t query_length(Instr_iter begin, Instr_iter end) {
+		std::size_t len = query_base.size();
+		for (auto instr = begin; instr != end; ++instr)
+			len += instr->size() + query_sep.size();
+		return len - query_sep.size();
+	}
+
+	// Split the instrument list into contiguous shards of near-equal size:
+	// at least opts.shards of them, and as many more as needed for every query string
+	// to fit in opts.max_url_length. A single instrument is never split.
+	//
+	// Ret: shard boundaries [Ret[i], Ret[i+1])
+	std::vector<Instr_iter> make_shards(std::vector<std::string> const& instrs, rates::Fetch_options const& opts) {
+		auto n = instrs.size();
+		if (!n)
+			throw std::invalid_argument("empty vector");
+		auto k = std::max<std::size_t>(opts.shards, 1);
+		if (opts.max_url_length > 0)
+			k = std::max(k, (query_length(instrs.begin(), instrs.end()) + opts.max_url_length - 1)
+					/ opts.max_url_length);
+		for (;; ++k) {
+			k = std::min(k, n);
+			std::vector<Instr_iter> bounds;
+			bool fits = true;
+			for (std::size_t i = 0; i <= k; ++i)
+				bounds.push_back(instrs.begin() + static_cast<std::ptrdiff_t>(i * n / k));
+			for (std::size_t i = 0; fits && i < k; ++i)
+				fits = (opts.max_url_length == 0 || bounds[i + 1] - bounds[i] == 1
+					|| query_length(bounds[i], bounds[i + 1]) <= opts.max_url_length);
+			if (fits || k == n)
+				return bounds;
+		}
+	}
+
+	typedef std::function<void(std::exception_ptr, std::vector<rates::Rate>)> Shard_done;
+
+	// Fetch one shard; done gets the error, or the rates, on the I/O thread.
+	void get_shard(Instr_iter begin, Instr_iter end, Shard_done done) {
+		using rates::Rate;
+		// The parser writes into the result vector, which the parser state refers to.
+		struct Shard {
+			std::vector<Rate> rates;
+			Price_parser parser;
+			Shard() : parser(rates) { }
+		};
+		auto shard (std::make_shared<Shard>());
+		shard->rates.reserve(static_cast<std::size_t>(end - begin));
+		http::async_query(make_query_url(begin, end),
+			[shard] (char const* data, std::size_t n) { shard->parser(data, n); },
+			[shard, done] (std::exception_ptr e) {
+				if (!e) {
+					try {
+						shard->parser.finish();
+					} catch (...) {
+						e = std::current_exception();
+					}
+				}
+				if (e)
+					done(e, std::vector<Rate>());
+				else
+					done(e, std::move(shard->rates));
+			});
+	}
+
+	// Shard results; whichever shard completes last merges them.
+	// Each shard writes only its own slots, so only the count is shared.
+	struct Merge {
+		std::vector<std::vector<rates::Rate>> parts;
+		std::vector<std::exception_ptr> errors;
+		std::atomic<std::size_t> pending;
+		std::promise<std::vector<rates::Rate>> promise;
+
+		explicit Merge(std::size_t n) : parts(n), errors(n), pending(n) { }
+
+		void done(std::size_t i, std::exception_ptr e, std::vector<rates::Rate> rates)
+		{
+			errors[i] = e;
+			parts[i] = std::move(rates);
+			if (pending.fetch_sub(1, std::memory_order_acq_rel) != 1)
+				return;
+			// The first error in shard order wins.
+			for (auto const& error : errors)
+				if (error) {
+					promise.set_exception(error);
+					return;
+				}
+			std::size_t n = 0;
+			for (auto const& part : parts)
+				n += part.size();
+			std::vector<rates::Rate> result;
+			result.reserve(n);
+			for (auto& part : parts)
+				result.insert(result.end(), part.begin(), part.end());
+			promise.set_value(std::move(result));
+		}
+	};
+
+	std::mutex fetch_options_mtx;
+	rates::Fetch_options current_fetch_options = { 1, 2048 };
+}
+
+rates::Fetch_options rates::fetch_options() {
+	std::lock_guard<std::mutex> lock(fetch_options_mtx);
+	return current_fetch_options;
+}
+
+void rates::set_fetch_options(Fetch_options const& opts) {
+	std::lock_guard<std::mutex> lock(fetch_options_mtx);
+	current_fetch_options = opts;
 }
 
 std::vector<rates::Rate> rates::get(std::vector<std::string> const& instruments) {
-	return parse_json(http::query(make_query_url(instruments)));
+	return get_async(instruments).get();
 }
 
+std::future<std::vector<rates::Rate>> rates::get_async(std::vector<std::string> const& instruments) {
+	auto bounds (make_shards(instruments, fetch_options()));
+	// All shards are in flight at once, each on its own connection;
+	// they are merged in shard order, which is instrument list order.
+	auto merge (std::make_shared<Merge>(bounds.size() - 1));
+	auto future (merge->promise.get_future());
+	for (std::size_t i = 0; i + 1 < bounds.size(); ++i)
+		get_shard(bounds[i], bounds[i + 1], [merge, i] (std::exception_ptr e, std::vector<Rate> rates) {
+			merge->done(i, e, std::move(rates));
+		});
+	return future;
+}
+
+std::vector<rates::Rate> rates::parse_prices(char const* data, std::size_t n) {
+	std::vector<Rate> result;
+	Price_parser parser (result);
+	parser(data, n);
+	parser.finish();
+	return result;
+}
@@ -8,12 +8,16 @@
 #ifndef RATES_HH
 #define RATES_HH
 
+#include <cstddef>
 #include <vector>
 #include <string>
+#include <future>
 #include <tuple>
 #include <ostream>
 #include <ext/prettyprint.hpp>
 
+#include <symbols.hh>
+
 namespace rates {
 
 // A structured form of a Rate for an Instrument
@@ -24,8 +28,15 @@ struct Rate {
 	double bid;
 	// asking rate
 	double ask;
+	// instrument currency ids
+	symbols::Instrument symbol;
+	// Throw: std::invalid_argument if instr isn't of the form BASE_QUOTE
 	Rate(std::string const& instr, double b, double a)
-	: instrument(instr), bid(b), ask(a)
+	: instrument(instr), bid(b), ask(a), symbol(symbols::intern_instrument(instr))
+	{ }
+	// Throw: std::out_of_range if sym has ids symbols doesn't know
+	Rate(symbols::Instrument sym, double b, double a)
+	: instrument(symbols::name(sym)), bid(b), ask(a), symbol(sym)
 	{ }
 	// comparator
 	bool operator< (Rate const& r) {
@@ -39,13 +50,47 @@ std::basic_ostream<CT,TT>& operator<< (std::basic_ostream<CT,TT>& os, Rate const
 	return os;
 }
 
+// Fetch_options.
+// Controls how get() splits the instrument list into concurrent requests.
+struct Fetch_options {
+	// minimum number of shards; 1 issues a single request where the URL length allows
+	std::size_t shards;
+	// maximum query string length; longer instrument lists get more shards; 0 is unlimited
+	std::size_t max_url_length;
+};
+
+// Fetch_options fetch_options().
+// Get the current sharding options; the defaults are { 1, 2048 }.
+Fetch_options fetch_options();
+
+// void set_fetch_options(Fetch_options const&).
+// Set the sharding options used by subsequent get() and get_async() calls.
+void set_fetch_options(Fetch_options const& opts);
+
 // std::vector<Rate> get(std::vector<std::string> const&).
 // Get a list of rates in response to a list of instruments.
+// The list is split into contiguous shards as per fetch_options(), which are fetched
+// concurrently over separate connections; the results are concatenated in list order.
 //
 // Arg: std::vector<std::string> const& instruments - the list of instruments
 // Ret: std::vector<Rate> - the corresponding list of rates
 std::vector<Rate> get(std::vector<std::string> const& instruments);
 
+// std::future<std::vector<Rate>> get_async(std::vector<std::string> const&).
+// Asynchronous counterpart of get(); the request runs on the http::client() I/O thread.
+//
+// Arg: std::vector<std::string> const& instruments - the list of instruments
+// Ret: std::future<std::vector<Rate>> - the corresponding list of rates, once available
+std::future<std::vector<Rate>> get_async(std::vector<std::string> const& instruments);
+
+// std::vector<Rate> parse_prices(char const*, std::size_t).
+// Parse a whole price response body, as get() does with the body pieces it receives.
+//
+// Arg: char const* data, std::size_t n - response body
+// Ret: std::vector<Rate> - the rates, in response order
+// Throw: std::invalid_argument if the body is ill-formed, or lacks a price field
+std::vector<Rate> parse_prices(char const* data, std::size_t n);
+
 }
 
 #endif
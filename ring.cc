@@ -0,0 +1,383 @@
+//          Copyright Andrey Moshbear 2014-2015.
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file LICENSE_1_0.txt or copy at
+//          http://www.boost.org/LICENSE_1_0.txt)
+//
+// Shared memory ring implementation
+//
+// Linking dependencies: -lboost_system -lrt
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cerrno>
+#include <cstdint>
+#include <new>
+#include <string>
+#include <stdexcept>
+#include <thread>
+
+#include <fcntl.h>
+#include <linux/futex.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <boost/system/error_code.hpp>
+#include <boost/system/system_error.hpp>
+
+#include <ring.hh>
+
+static_assert(ATOMIC_LLONG_LOCK_FREE == 2 && ATOMIC_INT_LOCK_FREE == 2 && sizeof(pid_t) == sizeof(std::int32_t),
+	      "ring needs lock-free atomics to share them between processes");
+
+// Shared state at the start of the mapping; the ring data follows it.
+// Producer and consumer fields are on separate cache lines.
+struct ring::detail::Control {
+	// set to `initialized` once the creator has set the rest up
+	std::atomic<std::uint32_t> ready;
+	std::uint32_t reserved;
+	std::uint64_t capacity;
+
+	// bytes published; written by the producer
+	alignas(64) std::atomic<std::uint64_t> head;
+	// futex word, bumped on every publish
+	std::atomic<std::uint32_t> published;
+	// the consumer is, or is about to be, asleep on `published`
+	std::atomic<std::uint32_t> consumer_asleep;
+	// the producer is done
+	std::atomic<std::uint32_t> closed;
+	// the producer's pid; 0 until it opens the ring, -1 once it's done
+	std::atomic<std::int32_t> writer_pid;
+	// bumped when a writer takes the ring over from an earlier one and starts it afresh
+	std::atomic<std::uint32_t> generation;
+
+	// bytes consumed; written by the consumer
+	alignas(64) std::atomic<std::uint64_t> tail;
+	// futex word, bumped on every consume
+	std::atomic<std::uint32_t> consumed;
+	// the producer is, or is about to be, asleep on `consumed`
+	std::atomic<std::uint32_t> producer_asleep;
+	// the consumer's pid; 0 until it opens the ring, -1 once it's done
+	std::atomic<std::int32_t> reader_pid;
+};
+
+namespace {
+
+	typedef ring::detail::Control Control;
+
+	const std::uint32_t initialized = 0x52494e47; // "RING"
+	// spins before sleeping, or before yielding between spins when polling
+	const int spins = 1000;
+	// how often a waiting end checks that the other one is still there
+	const std::chrono::milliseconds liveness_period (100);
+
+	boost::system::system_error os_error(std::string const& what)
+	{
+		return boost::system::system_error(
+			boost::system::error_code(errno, boost::system::system_category()), what);
+	}
+
+	void futex_wait(std::atomic<std::uint32_t>& word, std::uint32_t expected, std::chrono::nanoseconds timeout)
+	{
+		struct timespec ts;
+		ts.tv_sec = static_cast<time_t>(timeout.count() / 1000000000);
+		ts.tv_nsec = static_cast<long>(timeout.count() % 1000000000);
+		::syscall(SYS_futex, reinterpret_cast<std::uint32_t*>(&word), FUTEX_WAIT, expected,
+			  &ts, nullptr, 0);
+	}
+
+	void futex_wake(std::atomic<std::uint32_t>& word)
+	{
+		::syscall(SYS_futex, reinterpret_cast<std::uint32_t*>(&word), FUTEX_WAKE, 1,
+			  nullptr, nullptr, 0);
+	}
+
+	void cpu_relax()
+	{
+#if defined(__x86_64__) || defined(__i386__)
+		__builtin_ia32_pause();
+#endif
+	}
+
+	// Whether the end whose pid is in `pid` may still act on the ring: it hasn't opened it
+	// yet, or its process exists. A pid which has been reused passes for alive.
+	bool present(std::atomic<std::int32_t> const& pid)
+	{
+		auto p = pid.load();
+		if (p == 0)
+			return true;
+		if (p < 0)
+			return false;
+		return ::kill(p, 0) == 0 || errno != ESRCH;
+	}
+
+	// Wait until ready() holds. `seq` is bumped by the other end whenever it changes what
+	// ready() depends on, and `asleep` tells it a wake-up call is needed. The other end's
+	// pid is in `peer`; it's checked every liveness_period.
+	//
+	// Ret: false if the other end went away first
+	template <typename Ready>
+	bool wait_for(ring::Wait wait, std::atomic<std::uint32_t>& seq, std::atomic<std::uint32_t>& asleep,
+		      std::atomic<std::int32_t> const& peer, Ready ready)
+	{
+		typedef std::chrono::steady_clock Clock;
+		auto check = Clock::now() + liveness_period;
+		for (int i = 0; ; ++i) {
+			if (ready())
+				return true;
+			if (i < spins) {
+				cpu_relax();
+				continue;
+			}
+			if (Clock::now() >= check) {
+				// what it did before going away is still to be seen
+				if (!present(peer))
+					return ready();
+				check = Clock::now() + liveness_period;
+			}
+			if (wait == ring::Wait::poll) {
+				// in case the other end shares this core
+				std::this_thread::yield();
+				continue;
+			}
+			auto s = seq.load();
+			asleep.store(1);
+			// seq_cst: either the other end sees `asleep`, or this sees its update
+			if (!ready())
+				futex_wait(seq, s, liveness_period);
+			asleep.store(0);
+		}
+	}
+
+	void notify(std::atomic<std::uint32_t>& seq, std::atomic<std::uint32_t>& asleep)
+	{
+		seq.fetch_add(1);
+		if (asleep.load())
+			futex_wake(seq);
+	}
+}
+
+ring::detail::Mapping::Mapping(std::string const& name_, std::size_t capacity_)
+: name(name_), ctl(nullptr), data(nullptr), capacity(0), length(0)
+{
+	if (!capacity_ || (capacity_ & (capacity_ - 1)))
+		throw std::invalid_argument("ring capacity must be a power of two");
+	bool creator = true;
+	int fd = ::shm_open(name.c_str(), O_RDWR | O_CREAT | O_EXCL | O_CLOEXEC, 0600);
+	if (fd < 0 && errno == EEXIST) {
+		creator = false;
+		fd = ::shm_open(name.c_str(), O_RDWR | O_CLOEXEC, 0600);
+	}
+	if (fd < 0)
+		throw os_error("shm_open " + name);
+
+	if (creator) {
+		length = sizeof(Control) + capacity_;
+		if (::ftruncate(fd, static_cast<off_t>(length))) {
+			auto e = os_error("ftruncate " + name);
+			::close(fd);
+			::shm_unlink(name.c_str());
+			throw e;
+		}
+	} else {
+		// the creator may not have sized it yet
+		struct stat st;
+		for (;;) {
+			if (::fstat(fd, &st)) {
+				auto e = os_error("stat " + name);
+				::close(fd);
+				throw e;
+			}
+			if (static_cast<std::size_t>(st.st_size) > sizeof(Control))
+				break;
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		}
+		length = static_cast<std::size_t>(st.st_size);
+	}
+	void* map = ::mmap(nullptr, length, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	if (map == MAP_FAILED) {
+		auto e = os_error("mmap " + name);
+		::close(fd);
+		throw e;
+	}
+	::close(fd);
+
+	if (creator) {
+		ctl = new (map) Control();
+		ctl->capacity = capacity_;
+		ctl->head = 0;
+		ctl->published = 0;
+		ctl->consumer_asleep = 0;
+		ctl->closed = 0;
+		ctl->writer_pid = 0;
+		ctl->generation = 0;
+		ctl->tail = 0;
+		ctl->consumed = 0;
+		ctl->producer_asleep = 0;
+		ctl->reader_pid = 0;
+		ctl->ready.store(initialized, std::memory_order_release);
+	} else {
+		ctl = static_cast<Control*>(map);
+		while (ctl->ready.load(std::memory_order_acquire) != initialized)
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		if (sizeof(Control) + ctl->capacity != length) {
+			::munmap(map, length);
+			throw std::logic_error("ring " + name + " is of a bad size");
+		}
+	}
+	capacity = static_cast<std::size_t>(ctl->capacity);
+	data = reinterpret_cast<char*>(ctl + 1);
+}
+
+ring::detail::Mapping::~Mapping()
+{
+	::munmap(ctl, length);
+}
+
+ring::Writer::Writer(std::string const& name, Wait wait_, std::size_t capacity)
+: Mapping(name, capacity), wait(wait_), head(0)
+{
+	auto pid = static_cast<std::int32_t>(::getpid());
+	if (ctl->writer_pid.load() > 0 && present(ctl->writer_pid))
+		throw std::logic_error("ring " + name + " already has a writer");
+	if (ctl->writer_pid.load()) {
+		// Left over by an earlier writer, whose reader never read it all: start afresh.
+		ctl->writer_pid.store(pid);
+		if (!present(ctl->reader_pid))
+			ctl->reader_pid.store(0);
+		ctl->closed.store(0);
+		ctl->head.store(0);
+		ctl->tail.store(0);
+		ctl->generation.fetch_add(1);
+		notify(ctl->published, ctl->consumer_asleep);
+	} else {
+		ctl->writer_pid.store(pid);
+		head = static_cast<std::size_t>(ctl->head.load());
+	}
+	setp(data, data);
+}
+
+ring::Writer::~Writer()
+{
+	publish();
+	ctl->closed.store(1);
+	notify(ctl->published, ctl->consumer_asleep);
+	// As with a FIFO, the data is for a reader: wait for one to open the ring, if none has.
+	wait_for(wait, ctl->consumed, ctl->producer_asleep, ctl->reader_pid, [this] {
+		return ctl->reader_pid.load() != 0;
+	});
+	ctl->writer_pid.store(-1);
+	// a reader which died can't unlink the ring any more
+	if (ctl->reader_pid.load() > 0 && !present(ctl->reader_pid))
+		::shm_unlink(name.c_str());
+}
+
+void ring::Writer::publish()
+{
+	auto n = static_cast<std::size_t>(pptr() - pbase());
+	if (!n)
+		return;
+	head += n;
+	ctl->head.store(head);
+	setp(pptr(), epptr());
+	notify(ctl->published, ctl->consumer_asleep);
+}
+
+bool ring::Writer::acquire()
+{
+	if (!wait_for(wait, ctl->consumed, ctl->producer_asleep, ctl->reader_pid, [this] {
+		return head - static_cast<std::size_t>(ctl->tail.load()) < capacity;
+	}))
+		return false;
+	auto used = head - static_cast<std::size_t>(ctl->tail.load());
+	auto offset = head & (capacity - 1);
+	// up to the end of the ring, or of the free space, whichever comes first
+	auto n = std::min(capacity - used, capacity - offset);
+	setp(data + offset, data + offset + n);
+	return true;
+}
+
+ring::Writer::int_type ring::Writer::overflow(int_type c)
+{
+	publish();
+	if (!acquire())
+		return traits_type::eof();
+	if (traits_type::eq_int_type(c, traits_type::eof()))
+		return traits_type::not_eof(c);
+	*pptr() = traits_type::to_char_type(c);
+	pbump(1);
+	return c;
+}
+
+int ring::Writer::sync()
+{
+	publish();
+	return 0;
+}
+
+ring::Reader::Reader(std::string const& name, Wait wait_, std::size_t capacity)
+: Mapping(name, capacity), wait(wait_), tail(0), generation(0), stale(false)
+{
+	if (ctl->reader_pid.load() > 0 && present(ctl->reader_pid))
+		throw std::logic_error("ring " + name + " already has a reader");
+	generation = ctl->generation.load();
+	// A writer which is done already waited for a reader of its own; what it wrote isn't
+	// for this one, which waits for the next writer instead.
+	stale = ctl->writer_pid.load() && !present(ctl->writer_pid);
+	tail = static_cast<std::size_t>(ctl->tail.load());
+	ctl->reader_pid.store(static_cast<std::int32_t>(::getpid()));
+	notify(ctl->consumed, ctl->producer_asleep);
+	setg(data, data, data);
+}
+
+ring::Reader::~Reader()
+{
+	ctl->reader_pid.store(-1);
+	notify(ctl->consumed, ctl->producer_asleep);
+	::shm_unlink(name.c_str());
+}
+
+ring::Reader::int_type ring::Reader::underflow()
+{
+	// the get area is all read; hand its space back
+	auto n = static_cast<std::size_t>(egptr() - eback());
+	if (n) {
+		tail += n;
+		ctl->tail.store(tail);
+		setg(data, data, data);
+		notify(ctl->consumed, ctl->producer_asleep);
+	}
+	// while stale, there's no writer to check on
+	std::atomic<std::int32_t> no_writer (0);
+	for (;;) {
+		std::size_t head = 0;
+		// a writer which went away without closing the ring ends the stream all the same
+		wait_for(wait, ctl->published, ctl->consumer_asleep, stale ? no_writer : ctl->writer_pid, [&] {
+			if (ctl->generation.load() != generation)
+				return true;
+			head = static_cast<std::size_t>(ctl->head.load());
+			return !stale && (head != tail || ctl->closed.load());
+		});
+		if (ctl->generation.load() != generation) {
+			// a new writer took over the ring
+			generation = ctl->generation.load();
+			stale = false;
+			tail = 0;
+			continue;
+		}
+		head = static_cast<std::size_t>(ctl->head.load());
+		// a takeover is under way
+		if (head < tail)
+			continue;
+		if (head == tail)
+			return traits_type::eof();
+		auto offset = tail & (capacity - 1);
+		auto avail = std::min(head - tail, capacity - offset);
+		setg(data + offset, data + offset, data + offset + avail);
+		return traits_type::to_int_type(*gptr());
+	}
+}
@@ -0,0 +1,139 @@
+//          Copyright Andrey Moshbear 2014-2015.
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file LICENSE_1_0.txt or copy at
+//          http://www.boost.org/LICENSE_1_0.txt)
+//
+// Single-producer single-consumer byte ring in POSIX shared memory, as a transport between
+// pipeline processes in place of a pipe; the run-* drivers carry frames (see frame.hh) over it.
+//
+// The ring is a named shared memory object, created by whichever end opens it first and
+// unlinked by the consumer when it's done. Both ends are std::streambuf's whose get and put
+// areas lie in the ring itself, with no buffer of their own: sputn (as used by frame::Writer)
+// copies straight into the ring, and sgetn (std::istream::read, as used by frame::Reader)
+// straight out of it. Bytes are published on flush. A consumer waiting for data, or a producer waiting for space, either spins or
+// sleeps on a futex; the other end only makes a wake-up call when someone is asleep.
+//
+// As with a pipe, either end finds out when the other one goes away: each end's pid is kept
+// in the ring, and a waiting end checks on the other one every 100 ms. A reader whose writer
+// died sees the end of the stream after what was published; a writer whose reader is gone
+// fails to write (the streambuf returns eof, so the stream sets badbit). An end which hasn't
+// opened the ring yet is waited for, as long as it takes.
+//
+// A ring is for one writer and one reader at a time; another one of either throws. As with a
+// FIFO, a writer waits for a reader to open the ring before it's done, so the data of a writer
+// which is done when a reader comes along is a leftover, which the reader doesn't read:
+// it waits for the next writer, which restarts the ring from empty.
+//
+// Linux only (futex); linking dependencies: -lboost_system -lrt
+//
+#ifndef RING_HH
+#define RING_HH
+
+#include <cstddef>
+#include <cstdint>
+#include <streambuf>
+#include <string>
+
+namespace ring {
+
+	// How to wait on the other end
+	enum class Wait {
+		// sleep on a futex
+		futex,
+		// spin, yielding the core now and then; lowest latency, at the cost of a core
+		poll
+	};
+
+	// ring capacity, unless the creator asks for another
+	static const std::size_t default_capacity = 1 << 20;
+
+	namespace detail {
+		struct Control;
+
+		// A mapped ring, as either end sees it.
+		class Mapping {
+		public:
+			// Throw: boost::system::system_error if the ring can't be created or mapped
+			// Throw: std::invalid_argument if the capacity isn't a power of two
+			Mapping(std::string const& name_, std::size_t capacity);
+			~Mapping();
+
+			Mapping(Mapping const&) = delete;
+			Mapping& operator= (Mapping const&) = delete;
+
+		protected:
+			std::string name;
+			Control* ctl;
+			char* data;
+			std::size_t capacity;
+			std::size_t length;
+		};
+	}
+
+	// Writer.
+	// Producer end: a write-only std::streambuf; bytes are published on pubsync() (as by
+	// std::ostream::flush) and when the put area fills. Destruction publishes what remains,
+	// marks the end of the stream, and waits for a reader to have opened the ring.
+	class Writer : private detail::Mapping, public std::streambuf {
+	public:
+		// Writer(std::string const&, Wait, std::size_t).
+		// Open or create the ring `name`.
+		//
+		// Arg: std::string const& name - shared memory object name, e.g. "/currex-rates"
+		// Arg: Wait wait - how to wait for space
+		// Arg: std::size_t capacity - ring size if this end creates it; a power of two
+		// Throw: boost::system::system_error if the ring can't be created or mapped
+		// Throw: std::logic_error if the ring has another writer
+		explicit Writer(std::string const& name, Wait wait = Wait::futex,
+				std::size_t capacity = default_capacity);
+		~Writer();
+
+	protected:
+		int_type overflow(int_type c) override;
+		int sync() override;
+
+	private:
+		Wait wait;
+		// bytes published so far
+		std::size_t head;
+
+		void publish();
+		// Wait for free space and make it the put area.
+		// Ret: false if the reader went away instead
+		bool acquire();
+	};
+
+	// Reader.
+	// Consumer end: a read-only std::streambuf; the end of the stream is seen once the writer
+	// is destroyed, or has died, and everything it published is read. Destruction unlinks
+	// the ring.
+	class Reader : private detail::Mapping, public std::streambuf {
+	public:
+		// Reader(std::string const&, Wait, std::size_t).
+		// Open or create the ring `name`.
+		//
+		// Arg: std::string const& name - shared memory object name
+		// Arg: Wait wait - how to wait for data
+		// Arg: std::size_t capacity - ring size if this end creates it; a power of two
+		// Throw: boost::system::system_error if the ring can't be created or mapped
+		// Throw: std::logic_error if the ring has another reader
+		explicit Reader(std::string const& name, Wait wait = Wait::futex,
+				std::size_t capacity = default_capacity);
+		~Reader();
+
+	protected:
+		int_type underflow() override;
+
+	private:
+		Wait wait;
+		// bytes consumed so far, not counting the get area
+		std::size_t tail;
+		// the ring's generation as of the last look
+		std::uint32_t generation;
+		// the ring holds what an earlier writer left; wait for the next one
+		bool stale;
+	};
+
+}
+
+#endif
@@ -15,8 +15,9 @@
 #include <string>
 #include <stdexcept>
 #include <iostream>
-#include <boost/lexical_cast.hpp>
-#include <boost/tokenizer.hpp>
+#include <algorithm>
+
+#include <decimal.hh>
 
 int main() {
 	std::string path;
@@ -28,13 +29,15 @@ first:
 	std::getline(std::cin, line);
 	if (!line.size())
 		goto first;
-	boost::char_separator<char> sep(" ");
-	boost::tokenizer<decltype(sep)> line_tokens(line, sep);
-	std::vector<std::string> toks;
-	for (auto const& t: line_tokens)
-		toks.push_back(t);
-	path = toks[0];
-	lrate = boost::lexical_cast<double>(toks[1]);
+	// line ~ /path lrate/, space-separated
+	auto path_begin = line.find_first_not_of(' ');
+	auto path_end = line.find(' ', path_begin);
+	auto lrate_begin = line.find_first_not_of(' ', path_end);
+	if (lrate_begin == std::string::npos)
+		throw std::invalid_argument("Bad input: `" + line + "'");
+	auto lrate_end = std::min(line.find(' ', lrate_begin), line.size());
+	path = line.substr(path_begin, path_end - path_begin);
+	lrate = decimal::to_double(line.data() + lrate_begin, line.data() + lrate_end);
 	double x;
 	while (std::cin >> x) {
 		std::cout << exp(log(x) - lrate)
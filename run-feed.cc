@@ -0,0 +1,122 @@
+//          Copyright Andrey Moshbear 2014-2015.
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file LICENSE_1_0.txt or copy at
+//          http://www.boost.org/LICENSE_1_0.txt)
+//
+// Unit test/block for feed module.
+
+// Args: optional, in any order
+//	-d enables printing of header; -s suppresses it
+//	-n COUNT stops after COUNT ticks
+//	-h HOST[:PORT] streaming server, e.g. -h localhost:8080 for mock/httpd -s -p 8080
+//	-t dumps HTTP phase timings to stderr on exit
+// Input: each line of stdin specifies an instrument to subscribe to
+// Output: each line of output contains { Instrument Bid Ask } for each tick received, space-delimited
+
+#include <iostream>
+#include <string>
+#include <cstdlib>
+#include <cstring>
+#include <condition_variable>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <http.hh>
+#include <feed.hh>
+
+#define ARGCHK(x,a) !strncmp(x, a, sizeof a)
+
+int main (int argc, char** argv) {
+	bool print_hdr = false;
+	unsigned long long count = 0;
+	bool timings = false;
+	std::string domain ("stream-sandbox.oanda.com");
+	std::string service ("http");
+	for (int i = 1; i < argc; ++i) {
+		if (ARGCHK(argv[i], "-d"))
+			print_hdr = true;
+		else if (ARGCHK(argv[i], "-s"))
+			print_hdr = false;
+		else if (ARGCHK(argv[i], "-t"))
+			timings = true;
+		else if (ARGCHK(argv[i], "-n") && i + 1 < argc)
+			count = std::strtoull(argv[++i], nullptr, 10);
+		else if (ARGCHK(argv[i], "-h") && i + 1 < argc) {
+			std::string host (argv[++i]);
+			auto colon = host.find(':');
+			domain = host.substr(0, colon);
+			if (colon != std::string::npos)
+				service = host.substr(colon + 1);
+		}
+	}
+
+	std::vector<std::string> instruments;
+	while (std::cin.good()) {
+		std::string line;
+		std::getline(std::cin, line);
+		if (!line.size())
+			continue;
+		instruments.push_back(line);
+	}
+
+	if (print_hdr)
+		std::cout << "Instrument Bid Ask\n";
+	std::mutex mtx;
+	std::condition_variable cv;
+	unsigned long long seen = 0;
+	feed::Stream stream (instruments, [&] (rates::Rate const& price) {
+		std::lock_guard<std::mutex> lock(mtx);
+		if (count && seen >= count)
+			return;
+		std::cout << price.instrument << ' ' << price.bid << ' ' << price.ask << std::endl;
+		if (++seen == count)
+			cv.notify_all();
+	}, domain, service);
+
+	// Whatever ended the stream, if not stop(); reported once, on the way out.
+	std::exception_ptr error;
+	if (count) {
+		// The stream may also end before enough ticks arrive.
+		std::thread waiter ([&] {
+			std::exception_ptr e;
+			try {
+				stream.wait();
+			} catch (...) {
+				e = std::current_exception();
+			}
+			std::lock_guard<std::mutex> lock(mtx);
+			error = e;
+			seen = count;
+			cv.notify_all();
+		});
+		{
+			std::unique_lock<std::mutex> lock(mtx);
+			cv.wait(lock, [&] { return seen >= count; });
+		}
+		stream.stop();
+		waiter.join();
+	} else {
+		try {
+			stream.wait();
+		} catch (...) {
+			error = std::current_exception();
+		}
+	}
+	std::cout.flush();
+	if (timings)
+		std::cerr << http::phase_stats();
+
+	if (error) {
+		try {
+			std::rethrow_exception(error);
+		} catch (std::exception const& e) {
+			std::cerr << "run-feed: " << e.what() << std::endl;
+		} catch (...) {
+			std::cerr << "run-feed: stream failed" << std::endl;
+		}
+		return 1;
+	}
+	return 0;
+}
@@ -6,8 +6,18 @@
 //
 // Unit test/block for graph module.
 
+// Args: optional; -d LEVELS sets debug levels; -i FILE reads the rates from a binary snapshot
+//	 (as written by run-rates -o) instead of stdin
+//	 -b reads frames (see frame.hh) instead of text; -I NAME reads them from the shared memory ring NAME
+//	 (see ring.hh) instead of stdin; -P spins on the ring instead of sleeping
+//	 -s streams: reads rate updates (ticks) until the end of the input, applying each one to the graph
+//	 (starting from the -i snapshot, if any) and searching again; -L COUNT reports tick-to-signal latency
+//	 to stderr every COUNT ticks (default 10000; 0 only at the end)
 // Input: A list of rates
 // Output: The best path. An observation is made if this path is hamiltonian.
+//	   When streaming, the best path whenever it changes; an empty path means no cycle at all.
+//	   Latency reports: { ticks COUNT signals COUNT p50_ns NS p99_ns NS max_ns NS }, space-delimited,
+//	   over the ticks since the last report; latency runs from reading a tick to printing its signal, if any.
 #include <iostream>
 #include <vector>
 #include <string>
@@ -15,15 +25,22 @@
 #include <stdexcept>
 #include <cstring>
 #include <cctype>
-
-#include <boost/lexical_cast.hpp>
-#include <boost/tokenizer.hpp>
+#include <array>
+#include <utility>
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
 
 #include <d.hh>
+#include <decimal.hh>
 #include <g-common.hh>
 #include <g-color.hh>
 #include <g-rategraph.hh>
 #include <rates.hh>
+#include <snapshot.hh>
+#include <frame.hh>
+#include <ring.hh>
 #include <labeled.hh>
 #include <graph.hh>
 
@@ -40,6 +57,144 @@ using std::out_of_range;
 
 using std::array;
 
+namespace {
+
+	typedef labeled::Graph<g_rategraph::Graph> Labeled_graph;
+	typedef g_rategraph::Rated_path<g_rategraph::Graph> Rated_path;
+	typedef std::chrono::steady_clock Clock;
+
+	// A rate, or an update of one
+	struct Tick {
+		symbols::Instrument symbol;
+		double bid;
+		double ask;
+	};
+
+	// Parse a line ~ /u_v bid ask/, space-separated.
+	// Throw: std::invalid_argument if the line is ill-formed
+	Tick parse_rate(string const& line)
+	{
+		array<std::pair<char const*, char const*>, 3> toks;
+		size_t ntoks = 0;
+		for (char const* p = line.data(), * end = p + line.size(); p != end; ) {
+			if (*p == ' ') {
+				++p;
+				continue;
+			}
+			auto q = static_cast<char const*>(std::memchr(p, ' ', static_cast<size_t>(end - p)));
+			if (!q)
+				q = end;
+			if (ntoks == toks.size()) {
+				++ntoks;
+				break;
+			}
+			toks[ntoks++] = std::make_pair(p, q);
+			p = q;
+		}
+		if (ntoks != toks.size())
+			throw invalid_argument("Bad input: `" + line + "'");
+		Tick t;
+		t.symbol = symbols::intern_instrument(toks[0].first, static_cast<size_t>(toks[0].second - toks[0].first));
+		t.bid = decimal::to_double(toks[1].first, toks[1].second);
+		t.ask = decimal::to_double(toks[2].first, toks[2].second);
+		return t;
+	}
+
+	void print_path(Labeled_graph const& lg, Rated_path const& op)
+	{
+		auto const& P (op.path);
+		bool p_once = true;
+		for (auto const& p : P)
+			std::cout << lg.labels[p] << ((p != P[0] || p_once) ? ((p_once = false), ";") : "");
+		std::cout << ' ' << op.lrate << std::endl;
+	}
+
+	// Tick-to-signal latencies since the last report.
+	struct Tick_stats {
+		std::vector<std::int64_t> latency;
+		unsigned long long signals = 0;
+
+		void report()
+		{
+			if (latency.empty())
+				return;
+			std::sort(latency.begin(), latency.end());
+			std::cerr << "ticks " << latency.size() << " signals " << signals
+				  << " p50_ns " << latency[latency.size() / 2]
+				  << " p99_ns " << latency[latency.size() * 99 / 100]
+				  << " max_ns " << latency.back() << std::endl;
+			latency.clear();
+			signals = 0;
+		}
+	};
+
+	// Apply ticks from next(Tick&, Clock::time_point& read_at) until it returns false,
+	// printing the best path whenever it changes.
+	template <typename Next>
+	void stream_ticks(Labeled_graph& lg, unsigned long report_every, Next next)
+	{
+		graph::Updater<g_rategraph::Graph> update (lg);
+		Rated_path last;
+		if (bgl::num_vertices(lg.graph)) {
+			last = graph::best_path(lg);
+			print_path(lg, last);
+		}
+
+		Tick_stats stats;
+		stats.latency.reserve(report_every);
+		Tick tick;
+		Clock::time_point read_at;
+		while (next(tick, read_at)) {
+			update(tick.symbol, tick.bid, tick.ask);
+			auto op = graph::best_path(lg);
+			if (op.path != last.path) {
+				print_path(lg, op);
+				last = std::move(op);
+				++stats.signals;
+			}
+			stats.latency.push_back(std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - read_at).count());
+			if (stats.latency.size() == report_every)
+				stats.report();
+		}
+		stats.report();
+	}
+
+	// Frame tick source for stream_ticks.
+	struct Frame_ticks {
+		frame::Reader reader;
+		frame::Message m;
+
+		explicit Frame_ticks(std::istream& is) : reader(is) { }
+		bool operator()(Tick& tick, Clock::time_point& read_at)
+		{
+			if (!reader.next(m))
+				return false;
+			read_at = Clock::now();
+			if (m.type != frame::Type::rate)
+				throw std::logic_error("expected a rate frame");
+			tick = Tick { m.symbol, m.bid, m.ask };
+			return true;
+		}
+	};
+
+	// Text tick source for stream_ticks.
+	struct Text_ticks {
+		string line;
+
+		bool operator()(Tick& tick, Clock::time_point& read_at)
+		{
+			while (getline(std::cin, line)) {
+				read_at = Clock::now();
+				if (!line.size())
+					continue;
+				tick = parse_rate(line);
+				return true;
+			}
+			return false;
+		}
+	};
+}
+
 int main(int argc, char** argv) {
 	D_push_id(run_graph);
 	D_set_from_args(argc - 1, argv + 1, "-d");
@@ -49,38 +204,70 @@ int main(int argc, char** argv) {
 	// graph construction
 	vector<string> nodes;
 
-	labeled::Graph<g_rategraph::Graph> lg;
+	Labeled_graph lg;
 	graph::Input_description vrates;
 
-	while (std::cin.good()) {
-		string line;
-		getline(std::cin, line);
-		if (!line.size())
-			continue;
-		boost::char_separator<char> sep(" ");
-		boost::tokenizer<decltype(sep)> line_tokens(line, sep);
-		vector<string> toks;
-		for (auto const& t : line_tokens)
-			toks.push_back(t);
-		
-		if (toks.size() != 3)
-			throw invalid_argument("Bad input: `" + line + "'");
-		// line ~ /u_v bid ask/
-		string uv = toks[0];
-		double bid = boost::lexical_cast<double>(toks[1]);
-		double ask = boost::lexical_cast<double>(toks[2]);
-		vrates.push_back(rates::Rate(uv, bid, ask));
+	std::string snapshot_file;
+	bool binary = false;
+	std::string in_ring;
+	auto wait = ring::Wait::futex;
+	bool stream = false;
+	unsigned long report_every = 10000;
+	for (int i = 1; i < argc; ++i) {
+		if (!std::strcmp(argv[i], "-i") && i + 1 < argc)
+			snapshot_file = argv[++i];
+		else if (!std::strcmp(argv[i], "-b"))
+			binary = true;
+		else if (!std::strcmp(argv[i], "-I") && i + 1 < argc)
+			in_ring = argv[++i];
+		else if (!std::strcmp(argv[i], "-P"))
+			wait = ring::Wait::poll;
+		else if (!std::strcmp(argv[i], "-s"))
+			stream = true;
+		else if (!std::strcmp(argv[i], "-L") && i + 1 < argc)
+			report_every = std::strtoul(argv[++i], nullptr, 10);
+	}
+	if (!snapshot_file.empty()) {
+		snapshot::Snapshot snap (snapshot_file);
+		graph::load_graph_from_rates(lg, snap);
+	}
+
+	if (stream) {
+		if (!in_ring.empty()) {
+			ring::Reader ring_in (in_ring, wait);
+			std::istream is (&ring_in);
+			stream_ticks(lg, report_every, Frame_ticks(is));
+		} else if (binary) {
+			stream_ticks(lg, report_every, Frame_ticks(std::cin));
+		} else {
+			stream_ticks(lg, report_every, Text_ticks());
+		}
+		return 0;
+	}
+
+	if (snapshot_file.empty()) {
+		if (!in_ring.empty()) {
+			ring::Reader ring_in (in_ring, wait);
+			std::istream is (&ring_in);
+			vrates = frame::read_rates(is);
+		} else if (binary) {
+			vrates = frame::read_rates(std::cin);
+		} else {
+			string line;
+			while (std::cin.good()) {
+				getline(std::cin, line);
+				if (!line.size())
+					continue;
+				auto t = parse_rate(line);
+				vrates.emplace_back(t.symbol, t.bid, t.ask);
+			}
+		}
+		graph::load_graph_from_rates(lg, vrates);
 	}
-	graph::load_graph_from_rates(lg, vrates);
 
 	auto op = graph::best_path(lg);
-	
-	auto const& P (op.path);
-	if (P.size() == bgl::num_vertices(lg.graph))
+
+	if (op.path.size() == bgl::num_vertices(lg.graph))
 		D_print(D_info, std::cerr, "Hamiltonian.");
-	bool p_once = true;
-	for (auto const& p : P)
-		std::cout << lg.labels[p] << ((p != P[0] || p_once) ? ((p_once = false), ";") : "");
-	std::cout << ' ' << op.lrate << std::endl;
+	print_path(lg, op);
 }
-
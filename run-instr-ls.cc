@@ -5,21 +5,62 @@
 //
 // Unit test/block for instruments module
 
+// Args: optional; -t dumps HTTP phase timings to stderr; -b writes frames (see frame.hh) instead of text;
+//	-O NAME writes frames to the shared memory ring NAME (see ring.hh) instead of stdout;
+//	-P spins on the ring instead of sleeping
 // Output: each line of output contains an Instrument; graph is not guaranteed cyclic
 
 #include <iostream>
 #include <string>
+#include <cstring>
+#include <memory>
 #include <vector>
 
+#include <http.hh>
 #include <instr-ls.hh>
+#include <symbols.hh>
+#include <frame.hh>
+#include <ring.hh>
 
-int main() {
+#define ARGCHK(x,a) !strncmp(x, a, sizeof a)
+
+int main(int argc, char** argv) {
+	bool timings = false;
+	bool binary = false;
+	std::string out_ring;
+	auto wait = ring::Wait::futex;
+	for (int i = 1; i < argc; ++i) {
+		if (ARGCHK(argv[i], "-t"))
+			timings = true;
+		else if (ARGCHK(argv[i], "-b"))
+			binary = true;
+		else if (ARGCHK(argv[i], "-O") && i + 1 < argc)
+			out_ring = argv[++i];
+		else if (ARGCHK(argv[i], "-P"))
+			wait = ring::Wait::poll;
+	}
+	std::unique_ptr<ring::Writer> ring_out;
+	std::ostream os (std::cout.rdbuf());
+	if (!out_ring.empty()) {
+		ring_out.reset(new ring::Writer(out_ring, wait));
+		os.rdbuf(ring_out.get());
+		binary = true;
+	}
 
 	// parse and print
 	auto data = instruments::list();
-	for (const auto& instr : data)
-		std::cout << instr << '\n';
-	std::cout.flush();
+	if (binary) {
+		frame::Writer out (os);
+		for (const auto& instr : data)
+			out.instrument(symbols::intern_instrument(instr));
+		out.flush();
+	} else {
+		for (const auto& instr : data)
+			std::cout << instr << '\n';
+		std::cout.flush();
+	}
+	if (timings)
+		std::cerr << http::phase_stats();
 
 	return 0;
 }
@@ -5,6 +5,10 @@
 //
 // Unit test/block for pruner module
 
+// Args: optional; -d LEVELS sets debug levels; -b reads and writes frames (see frame.hh) instead of text;
+//	-I NAME, -O NAME read, write frames from, to the shared memory ring NAME (see ring.hh) instead of
+//	stdin, stdout; each affects only its own end, so -I alone still writes text; -P spins on rings
+//	instead of sleeping
 // Input: Each line of stdin specifies a ${SRC_LABEL}_${DST_LABEL} edge
 // Output: New edges printed to stdout
 // For debugging, the numerical form of the graph is printed a GraphViz DOT file `pre.dot`
@@ -14,10 +18,14 @@
 #include <vector>
 #include <cstring>
 #include <cctype>
+#include <memory>
 #include <string>
 #include <stdexcept>
 
 #include <pruner.hh>
+#include <symbols.hh>
+#include <frame.hh>
+#include <ring.hh>
 #include <d.hh>
 
 using std::vector;
@@ -29,18 +37,54 @@ using std::out_of_range;
 
 int main (int argc, char** argv) {
 	D_set_from_args(argc - 1, argv + 1, "-d");
+	bool binary = false;
+	std::string in_ring, out_ring;
+	auto wait = ring::Wait::futex;
+	for (int i = 1; i < argc; ++i) {
+		if (!std::strcmp(argv[i], "-b"))
+			binary = true;
+		else if (!std::strcmp(argv[i], "-I") && i + 1 < argc)
+			in_ring = argv[++i];
+		else if (!std::strcmp(argv[i], "-O") && i + 1 < argc)
+			out_ring = argv[++i];
+		else if (!std::strcmp(argv[i], "-P"))
+			wait = ring::Wait::poll;
+	}
+	std::unique_ptr<ring::Reader> ring_in;
+	std::unique_ptr<ring::Writer> ring_out;
+	std::istream is (std::cin.rdbuf());
+	std::ostream os (std::cout.rdbuf());
+	if (!in_ring.empty()) {
+		ring_in.reset(new ring::Reader(in_ring, wait));
+		is.rdbuf(ring_in.get());
+	}
+	if (!out_ring.empty()) {
+		ring_out.reset(new ring::Writer(out_ring, wait));
+		os.rdbuf(ring_out.get());
+	}
 
-	std::vector<std::string> input;
-	while (std::cin.good()) {
-		std::string line;
-		std::getline(std::cin, line);
-		if (!line.size())
-			continue;
-		input.push_back(line);
+	std::vector<symbols::Instrument> input;
+	if (binary || !in_ring.empty()) {
+		input = frame::read_instruments(is);
+	} else {
+		while (is.good()) {
+			std::string line;
+			std::getline(is, line);
+			if (!line.size())
+				continue;
+			input.push_back(symbols::intern_instrument(line));
+		}
 	}
 	auto res = pruner(input);
-	for (auto const& e : res)
-		std::cout << e << '\n';
-	std::cout.flush();
+	if (binary || !out_ring.empty()) {
+		frame::Writer out (os);
+		for (auto const& e : res)
+			out.instrument(e);
+		out.flush();
+	} else {
+		for (auto const& e : res)
+			os << symbols::name(e) << '\n';
+		os.flush();
+	}
 }
 
@@ -5,43 +5,100 @@
 //
 // Unit test/block for rates module.
 
-// Args: optional; -d enables printing of header; -s suppresses it
+// Args: optional; -d enables printing of header; -s suppresses it; -t dumps HTTP phase timings to stderr;
+//	-o FILE also writes the rates to FILE as a binary snapshot, for run-graph -i
+//	-b reads and writes frames (see frame.hh) instead of text;
+//	-I NAME, -O NAME read, write frames from, to the shared memory ring NAME (see ring.hh) instead of
+//	stdin, stdout; each affects only its own end, so -I alone still writes text; -P spins on rings
+//	instead of sleeping
 // Input: each line of stdin specifies an instrument to query
 // Output: each line of output contains { Instrument Bid Ask } for each input Instrument, space-delimited
 
 #include <iostream>
 #include <string>
 #include <cstring>
+#include <memory>
 #include <vector>
 
+#include <http.hh>
 #include <rates.hh>
+#include <snapshot.hh>
+#include <symbols.hh>
+#include <frame.hh>
+#include <ring.hh>
 
 #define ARGCHK(x,a) !strncmp(x, a, sizeof a)
 
 int main (int argc, char** argv) {
 	bool print_hdr = false;
-	if (argc >= 2) {
-		if (ARGCHK(argv[1], "-d"))
+	bool timings = false;
+	bool binary = false;
+	std::string snapshot_file;
+	std::string in_ring, out_ring;
+	auto wait = ring::Wait::futex;
+	for (int i = 1; i < argc; ++i) {
+		if (ARGCHK(argv[i], "-d"))
 			print_hdr = true;
-		else if(ARGCHK(argv[1], "-s"))
+		else if(ARGCHK(argv[i], "-s"))
 			print_hdr = false;
+		else if (ARGCHK(argv[i], "-t"))
+			timings = true;
+		else if (ARGCHK(argv[i], "-b"))
+			binary = true;
+		else if (ARGCHK(argv[i], "-o") && i + 1 < argc)
+			snapshot_file = argv[++i];
+		else if (ARGCHK(argv[i], "-I") && i + 1 < argc)
+			in_ring = argv[++i];
+		else if (ARGCHK(argv[i], "-O") && i + 1 < argc)
+			out_ring = argv[++i];
+		else if (ARGCHK(argv[i], "-P"))
+			wait = ring::Wait::poll;
 	}
+	std::unique_ptr<ring::Reader> ring_in;
+	std::unique_ptr<ring::Writer> ring_out;
+	std::istream is (std::cin.rdbuf());
+	std::ostream os (std::cout.rdbuf());
+	if (!in_ring.empty()) {
+		ring_in.reset(new ring::Reader(in_ring, wait));
+		is.rdbuf(ring_in.get());
+	}
+	if (!out_ring.empty()) {
+		ring_out.reset(new ring::Writer(out_ring, wait));
+		os.rdbuf(ring_out.get());
+	}
+	// -I reads frames, -O writes them; -b makes both ends frames
+	bool binary_in = binary || !in_ring.empty();
+	bool binary_out = binary || !out_ring.empty();
 
 	std::vector<std::string> instruments;
-	while (std::cin.good()) {
+	if (binary_in)
+		for (auto const& instr : frame::read_instruments(is))
+			instruments.push_back(symbols::name(instr));
+	while (!binary_in && is.good()) {
 		std::string line;
-		std::getline(std::cin, line);
+		std::getline(is, line);
 		if (!line.size())
 			continue;
 		instruments.push_back(line);
 	}
 
 	auto data = rates::get(instruments);
-	if (print_hdr)
-		std::cout << "Instrument Bid Ask\n";
-	for (const auto& price : data) 
-		std::cout << price.instrument << ' ' << price.bid << ' ' << price.ask << '\n';
-	std::cout.flush();
+	if (binary_out) {
+		frame::Writer out (os);
+		for (const auto& price : data)
+			out.rate(price);
+		out.flush();
+	} else {
+		if (print_hdr)
+			os << "Instrument Bid Ask\n";
+		for (const auto& price : data)
+			os << price.instrument << ' ' << price.bid << ' ' << price.ask << '\n';
+		os.flush();
+	}
+	if (!snapshot_file.empty())
+		snapshot::save(snapshot_file, data);
+	if (timings)
+		std::cerr << http::phase_stats();
 
 	return 0;
 }
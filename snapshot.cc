@@ -0,0 +1,185 @@
+//          Copyright Andrey Moshbear 2014-2015.
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file LICENSE_1_0.txt or copy at
+//          http://www.boost.org/LICENSE_1_0.txt)
+//
+// Snapshot implementation
+//
+// Linking dependencies: -lboost_system
+
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <limits>
+#include <ostream>
+#include <string>
+#include <stdexcept>
+#include <type_traits>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <boost/system/error_code.hpp>
+#include <boost/system/system_error.hpp>
+
+#include <util.hh>
+#include <snapshot.hh>
+
+namespace {
+
+	typedef snapshot::Snapshot::Record Record;
+
+	static_assert(sizeof(snapshot::Header) == 40, "snapshot::Header isn't packed");
+	static_assert(sizeof(Record) == 24 && std::is_standard_layout<Record>::value,
+		      "Snapshot::Record isn't packed");
+
+	const char magic[8] = "CXRATES";
+	const std::uint32_t byte_order = 0x01020304;
+	const std::uint32_t version = 1;
+	const std::uint32_t npos = static_cast<std::uint32_t>(-1);
+
+	std::size_t padded(std::size_t n)
+	{ return (n + 7) & ~std::size_t(7); }
+
+	boost::system::system_error os_error(std::string const& what)
+	{
+		return boost::system::system_error(
+			boost::system::error_code(errno, boost::system::system_category()), what);
+	}
+}
+
+void snapshot::write(std::ostream& os, std::vector<rates::Rate> const& rates)
+{
+	// symbols::Id -> snapshot id
+	std::vector<std::uint32_t> local (symbols::size(), npos);
+	std::string names;
+	std::vector<Record> records;
+	std::uint32_t currencies = 0;
+	auto id = [&] (symbols::Id s) {
+		if (local[s] == npos) {
+			local[s] = currencies++;
+			names += symbols::name(s);
+			names += '\0';
+		}
+		return local[s];
+	};
+	records.reserve(rates.size());
+	for (auto const& r : rates)
+		records.push_back({ id(r.symbol.base), id(r.symbol.quote), r.bid, r.ask });
+	names.resize(padded(names.size()), '\0');
+
+	Header h;
+	std::memcpy(h.magic, magic, sizeof h.magic);
+	h.byte_order = byte_order;
+	h.version = version;
+	h.currencies = currencies;
+	h.reserved = 0;
+	h.names_size = names.size();
+	h.records = records.size();
+	os.write(reinterpret_cast<char const*>(&h), sizeof h);
+	os.write(names.data(), util::checked_cast<std::streamsize>(names.size()));
+	os.write(reinterpret_cast<char const*>(records.data()),
+		 util::checked_cast<std::streamsize>(records.size() * sizeof(Record)));
+	if (!os.flush())
+		throw std::runtime_error("can't write snapshot");
+}
+
+void snapshot::save(std::string const& path, std::vector<rates::Rate> const& rates)
+{
+	auto tmp = path + ".tmp";
+	// A failed save leaves neither a partial snapshot nor the temporary file behind.
+	try {
+		std::ofstream f (tmp.c_str(), std::ios::binary | std::ios::trunc);
+		if (!f)
+			throw std::runtime_error("can't write snapshot to " + tmp);
+		write(f, rates);
+	} catch (...) {
+		std::remove(tmp.c_str());
+		throw;
+	}
+	if (std::rename(tmp.c_str(), path.c_str())) {
+		auto e = os_error("rename " + tmp + " to " + path);
+		std::remove(tmp.c_str());
+		throw e;
+	}
+}
+
+snapshot::Snapshot::Snapshot(std::string const& path)
+: map(MAP_FAILED), length(0), records(nullptr), count(0)
+{
+	int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+	if (fd < 0)
+		throw os_error("open " + path);
+	struct stat st;
+	if (::fstat(fd, &st)) {
+		auto e = os_error("stat " + path);
+		::close(fd);
+		throw e;
+	}
+	length = static_cast<std::size_t>(st.st_size);
+	if (length < sizeof(Header)) {
+		::close(fd);
+		throw std::logic_error("snapshot " + path + " is truncated");
+	}
+	map = ::mmap(nullptr, length, PROT_READ, MAP_SHARED, fd, 0);
+	if (map == MAP_FAILED) {
+		auto e = os_error("mmap " + path);
+		::close(fd);
+		throw e;
+	}
+	::close(fd);
+
+	try {
+		auto base = static_cast<char const*>(map);
+		Header const& h = *reinterpret_cast<Header const*>(base);
+		if (std::memcmp(h.magic, magic, sizeof h.magic))
+			throw std::logic_error("not a snapshot: " + path);
+		if (h.byte_order != byte_order)
+			throw std::logic_error("snapshot " + path + " is of another byte order");
+		if (h.version != version)
+			throw std::logic_error("snapshot " + path + " is of an unknown version");
+		auto body = length - sizeof(Header);
+		if (h.names_size > body || h.names_size % 8
+		    || h.records != (body - h.names_size) / sizeof(Record)
+		    || (body - h.names_size) % sizeof(Record))
+			throw std::logic_error("snapshot " + path + " is truncated");
+
+		// intern the currencies
+		char const* name = base + sizeof(Header);
+		char const* names_end = name + h.names_size;
+		ids.reserve(h.currencies);
+		for (std::uint32_t i = 0; i < h.currencies; ++i) {
+			auto nul = static_cast<char const*>(std::memchr(name, '\0', static_cast<std::size_t>(names_end - name)));
+			if (!nul || nul == name)
+				throw std::logic_error("snapshot " + path + " has a bad currency table");
+			ids.push_back(symbols::intern(std::string(name, nul)));
+			name = nul + 1;
+		}
+
+		records = reinterpret_cast<Record const*>(names_end);
+		count = static_cast<std::size_t>(h.records);
+	} catch (...) {
+		::munmap(map, length);
+		throw;
+	}
+}
+
+snapshot::Snapshot::~Snapshot()
+{
+	::munmap(map, length);
+}
+
+std::vector<rates::Rate> snapshot::Snapshot::rates() const
+{
+	std::vector<rates::Rate> out;
+	out.reserve(count);
+	for (auto const& r : *this) {
+		auto s = symbol(r);
+		out.emplace_back(symbols::name(s), r.bid, r.ask);
+	}
+	return out;
+}
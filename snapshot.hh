@@ -0,0 +1,116 @@
+//          Copyright Andrey Moshbear 2014-2015.
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file LICENSE_1_0.txt or copy at
+//          http://www.boost.org/LICENSE_1_0.txt)
+//
+// Binary rate snapshots, for cold start, replay and passing rates between processes.
+//
+// Layout, in native byte order:
+//	Header		40 bytes, below
+//	currency names	NUL-terminated, in snapshot id order, NUL-padded to a multiple of 8 bytes
+//	records		fixed-width Snapshot::Record's, 24 bytes each
+// Currency ids in a snapshot are its own, dense from 0; they're mapped to symbols ids on load.
+// A snapshot is used in place through mmap: loading it costs one symbols lookup per currency,
+// and nothing per rate.
+//
+#ifndef SNAPSHOT_HH
+#define SNAPSHOT_HH
+
+#include <cstddef>
+#include <cstdint>
+#include <iosfwd>
+#include <string>
+#include <vector>
+
+#include <symbols.hh>
+#include <rates.hh>
+
+namespace snapshot {
+
+	struct Header {
+		// "CXRATES" and a NUL
+		char magic[8];
+		// 0x01020304 as written; tells a snapshot from another byte order apart
+		std::uint32_t byte_order;
+		// format version, 1
+		std::uint32_t version;
+		// number of currencies
+		std::uint32_t currencies;
+		std::uint32_t reserved;
+		// size of the currency names, padding included
+		std::uint64_t names_size;
+		// number of records
+		std::uint64_t records;
+	};
+
+	// void write(std::ostream&, std::vector<rates::Rate> const&).
+	// Write rates to a stream as a snapshot; only currencies the rates refer to are included.
+	//
+	// Arg: std::ostream& os - output
+	// Arg: std::vector<rates::Rate> const& rates - the rates
+	// Throw: std::runtime_error if the stream fails
+	void write(std::ostream& os, std::vector<rates::Rate> const& rates);
+
+	// void save(std::string const&, std::vector<rates::Rate> const&).
+	// Write rates to a file as a snapshot. The file is written under a temporary name and
+	// renamed into place, so that a reader never maps a partly written snapshot.
+	//
+	// Arg: std::string const& path - output file
+	// Arg: std::vector<rates::Rate> const& rates - the rates
+	// Throw: std::runtime_error if the file can't be written
+	// Throw: boost::system::system_error if it can't be renamed into place
+	void save(std::string const& path, std::vector<rates::Rate> const& rates);
+
+	// Snapshot.
+	// A snapshot file mapped read-only into memory; the records are read where they lie.
+	class Snapshot {
+	public:
+		struct Record {
+			// snapshot currency ids
+			std::uint32_t base;
+			std::uint32_t quote;
+			double bid;
+			double ask;
+		};
+
+		// Map a snapshot and intern its currencies.
+		//
+		// Arg: std::string const& path - the snapshot file
+		// Throw: boost::system::system_error if the file can't be opened or mapped
+		// Throw: std::logic_error if the file isn't a well-formed snapshot
+		explicit Snapshot(std::string const& path);
+		~Snapshot();
+
+		Snapshot(Snapshot const&) = delete;
+		Snapshot& operator= (Snapshot const&) = delete;
+
+		Record const* begin() const
+		{ return records; }
+		Record const* end() const
+		{ return records + count; }
+		std::size_t size() const
+		{ return count; }
+
+		// symbols::Instrument symbol(Record const&) const.
+		// Translate the currency ids of a record into symbols ids.
+		//
+		// Throw: std::out_of_range if the record refers to a currency the snapshot lacks
+		symbols::Instrument symbol(Record const& r) const
+		{ return { ids.at(r.base), ids.at(r.quote) }; }
+
+		// std::vector<rates::Rate> rates() const.
+		// Copy the records out as rates.
+		std::vector<rates::Rate> rates() const;
+
+	private:
+		void* map;
+		std::size_t length;
+		Record const* records;
+		std::size_t count;
+		// snapshot currency id -> symbols::Id
+		std::vector<symbols::Id> ids;
+	};
+
+}
+
+#endif
@@ -0,0 +1,125 @@
+//          Copyright Andrey Moshbear 2014-2015.
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file LICENSE_1_0.txt or copy at
+//          http://www.boost.org/LICENSE_1_0.txt)
+//
+// Symbol table implementation
+//
+// Linking dependencies: -lpthread
+
+#include <cstring>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <stdexcept>
+#include <unordered_map>
+#include <boost/functional/hash.hpp>
+#include <boost/utility/string_ref.hpp>
+
+#include <util.hh>
+#include <symbols.hh>
+
+namespace {
+
+	// A name and its hash, which is computed before taking the table lock.
+	// While looking up, the view refers to the caller's buffer; as a table key, to the
+	// table's own copy of the name.
+	struct Key {
+		boost::string_ref name;
+		std::size_t hash;
+
+		Key(boost::string_ref s, std::size_t h) : name(s), hash(h) { }
+		explicit Key(boost::string_ref s) : Key(s, boost::hash_range(s.begin(), s.end())) { }
+
+		bool operator== (Key const& k) const
+		{ return name == k.name; }
+	};
+
+	struct Key_hash {
+		std::size_t operator() (Key const& k) const
+		{ return k.hash; }
+	};
+
+	// The table; rates parses shards concurrently, so lookups are serialized.
+	// Names live in deques, since references to them are handed out and it never moves them.
+	struct Table {
+		std::mutex mtx;
+		// currency names, by id
+		std::deque<std::string> names;
+		// instrument names, which only back the keys of `instruments`
+		std::deque<std::string> instrument_names;
+		std::unordered_map<Key, symbols::Id, Key_hash> currencies;
+		std::unordered_map<Key, symbols::Instrument, Key_hash> instruments;
+
+		symbols::Id intern(Key const& currency) {
+			auto it = currencies.find(currency);
+			if (it != currencies.end())
+				return it->second;
+			auto id = util::checked_cast<symbols::Id>(names.size());
+			names.emplace_back(currency.name.data(), currency.name.size());
+			currencies.emplace(Key(names.back(), currency.hash), id);
+			return id;
+		}
+	};
+
+	Table& table()
+	{
+		static Table t;
+		return t;
+	}
+}
+
+symbols::Id symbols::intern(std::string const& currency)
+{
+	auto& t = table();
+	Key key (currency);
+	std::lock_guard<std::mutex> lock(t.mtx);
+	return t.intern(key);
+}
+
+symbols::Instrument symbols::intern_instrument(char const* name, std::size_t n)
+{
+	auto& t = table();
+	Key key (boost::string_ref(name, n));
+	{
+		std::lock_guard<std::mutex> lock(t.mtx);
+		auto it = t.instruments.find(key);
+		if (it != t.instruments.end())
+			return it->second;
+	}
+	// First sighting: split and hash outside the lock, then add it unless another thread has.
+	auto sep = static_cast<char const*>(std::memchr(name, separator, n));
+	if (!sep || sep == name || sep == name + n - 1)
+		throw std::invalid_argument("Bad instrument: `" + std::string(name, n) + "'");
+	Key base (boost::string_ref(name, static_cast<std::size_t>(sep - name)));
+	Key quote (boost::string_ref(sep + 1, static_cast<std::size_t>(name + n - sep - 1)));
+	std::lock_guard<std::mutex> lock(t.mtx);
+	auto it = t.instruments.find(key);
+	if (it != t.instruments.end())
+		return it->second;
+	Instrument ids { t.intern(base), t.intern(quote) };
+	t.instrument_names.emplace_back(name, n);
+	t.instruments.emplace(Key(t.instrument_names.back(), key.hash), ids);
+	return ids;
+}
+
+std::string const& symbols::name(Id id)
+{
+	auto& t = table();
+	std::lock_guard<std::mutex> lock(t.mtx);
+	return t.names.at(id);
+}
+
+std::string symbols::name(Instrument instr)
+{
+	auto& t = table();
+	std::lock_guard<std::mutex> lock(t.mtx);
+	return t.names.at(instr.base) + separator + t.names.at(instr.quote);
+}
+
+std::size_t symbols::size()
+{
+	auto& t = table();
+	std::lock_guard<std::mutex> lock(t.mtx);
+	return t.names.size();
+}
@@ -0,0 +1,72 @@
+//          Copyright Andrey Moshbear 2014-2015.
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file LICENSE_1_0.txt or copy at
+//          http://www.boost.org/LICENSE_1_0.txt)
+//
+// Process-wide symbol table: currencies are interned to dense integer ids, and instruments
+// to pairs thereof, so that later stages compare and index by integer instead of by name.
+// Ids are handed out in order of first appearance from 0 and are never reused.
+//
+#ifndef SYMBOLS_HH
+#define SYMBOLS_HH
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace symbols {
+
+	// dense currency id
+	typedef std::uint32_t Id;
+
+	// An instrument BASE_QUOTE as a pair of currency ids.
+	struct Instrument {
+		Id base;
+		Id quote;
+	};
+
+	// separator between the currencies of an instrument name
+	static const char separator = '_';
+
+	// Id intern(std::string const&).
+	// Get the id of a currency, adding it to the table if it's new.
+	//
+	// Arg: std::string const& currency - the currency name
+	// Ret: its id
+	Id intern(std::string const& currency);
+
+	// Instrument intern_instrument(char const*, std::size_t).
+	// Get the currency ids of an instrument, adding them to the table if new.
+	// Whole instrument names are remembered as well, so a name seen before costs one lookup.
+	//
+	// Arg: char const* name, std::size_t n - the instrument name, BASE_QUOTE
+	// Ret: the currency ids, split at the first separator
+	// Throw: std::invalid_argument if the name isn't two nonempty currencies around a separator
+	Instrument intern_instrument(char const* name, std::size_t n);
+
+	inline Instrument intern_instrument(std::string const& name)
+	{ return intern_instrument(name.data(), name.size()); }
+
+	// std::string const& name(Id).
+	// Get the name of a currency; the reference stays valid for the life of the process.
+	//
+	// Arg: Id id - the currency id
+	// Ret: its name
+	// Throw: std::out_of_range if no currency has that id
+	std::string const& name(Id id);
+
+	// std::string name(Instrument).
+	// Get the name of an instrument.
+	//
+	// Arg: Instrument instr - the instrument
+	// Ret: its name, BASE_QUOTE
+	// Throw: std::out_of_range if no currency has either id
+	std::string name(Instrument instr);
+
+	// std::size_t size().
+	// Get the number of currencies interned so far; every id is less than it.
+	std::size_t size();
+
+}
+
+#endif